@@ -0,0 +1,339 @@
+/*
+ * cache.c - The set associative cache model behind csim
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "cache.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_LINE_SIZE 64
+
+// How many accesses ahead of the current one accessCacheBatch prefetches sets.
+#define PREFETCH_DISTANCE 8
+
+static size_t roundToHostLine(size_t size) {
+	return (size + HOST_LINE_SIZE - 1) / HOST_LINE_SIZE * HOST_LINE_SIZE;
+}
+
+static inline unsigned long long *setTags(const struct cache *cache, unsigned int set) {
+	return (unsigned long long *)(cache->storage + set * cache->setStride);
+}
+
+static inline unsigned long long *setValid(const struct cache *cache, unsigned int set) {
+	return (unsigned long long *)(cache->storage + set * cache->setStride + cache->validOffset);
+}
+
+static inline unsigned long long *setDirty(const struct cache *cache, unsigned int set) {
+	return (unsigned long long *)(cache->storage + set * cache->setStride + cache->dirtyOffset);
+}
+
+static inline void *setPolicy(const struct cache *cache, unsigned int set) {
+	return cache->storage + set * cache->setStride + cache->policyOffset;
+}
+
+// The tag index of a set: the number of valid lines, then one slot per 2^indexBits holding line + 1, or 0 if empty.
+struct tagIndex {
+	int used;
+	int slots[];
+};
+
+static inline struct tagIndex *setIndex(const struct cache *cache, unsigned int set) {
+	return (struct tagIndex *)(cache->storage + set * cache->setStride + cache->indexOffset);
+}
+
+static inline unsigned long long indexSlot(const struct cache *cache, unsigned long long tag) {
+	return (tag * 0x9E3779B97F4A7C15ULL) >> (64 - cache->indexBits);
+}
+
+// Return the line of the set holding tag, or -1 if none does. Only valid lines are ever in the index.
+static int indexFind(const struct cache *cache, unsigned int set, unsigned long long tag) {
+	const unsigned long long *tags = setTags(cache, set);
+	const struct tagIndex *index = setIndex(cache, set);
+	unsigned long long mask = (1ULL << cache->indexBits) - 1;
+
+	for (unsigned long long slot = indexSlot(cache, tag); index->slots[slot] != 0; slot = (slot + 1) & mask) {
+		if (tags[index->slots[slot] - 1] == tag) {
+			return index->slots[slot] - 1;
+		}
+	}
+	return -1;
+}
+
+static void indexInsert(struct cache *cache, unsigned int set, int line) {
+	struct tagIndex *index = setIndex(cache, set);
+	unsigned long long mask = (1ULL << cache->indexBits) - 1;
+	unsigned long long slot = indexSlot(cache, setTags(cache, set)[line]);
+
+	while (index->slots[slot] != 0) {
+		slot = (slot + 1) & mask;
+	}
+	index->slots[slot] = line + 1;
+	index->used++;
+}
+
+// Take the line out of the index while its tag is still in place. The entries after it in its probe run are shifted
+// back so that no run is ever broken by an empty slot.
+static void indexRemove(struct cache *cache, unsigned int set, int line) {
+	const unsigned long long *tags = setTags(cache, set);
+	struct tagIndex *index = setIndex(cache, set);
+	unsigned long long mask = (1ULL << cache->indexBits) - 1;
+	unsigned long long hole = indexSlot(cache, tags[line]);
+
+	while (index->slots[hole] != line + 1) {
+		hole = (hole + 1) & mask;
+	}
+	for (unsigned long long slot = (hole + 1) & mask; index->slots[slot] != 0; slot = (slot + 1) & mask) {
+		unsigned long long home = indexSlot(cache, tags[index->slots[slot] - 1]);
+		if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+			index->slots[hole] = index->slots[slot];
+			hole = slot;
+		}
+	}
+	index->slots[hole] = 0;
+	index->used--;
+}
+
+// Allocate and initialize the cache. Returns 0, or -1 if its storage could not be allocated.
+int createCache(struct cache *cache, const struct cacheConfig *config) {
+	int numLines = config->numLines;
+
+	cache->numSetIndexBits = config->numSetIndexBits;
+	cache->numSets = 1 << config->numSetIndexBits;
+	cache->numLines = numLines;
+	cache->blockSize = config->blockSize;
+	cache->policy = config->policy;
+	cache->writeThrough = config->writeThrough;
+	cache->noWriteAllocate = config->noWriteAllocate;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->evictions = 0;
+	cache->writebacks = 0;
+	cache->fillBytes = 0;
+	cache->writebackBytes = 0;
+	cache->directWriteBytes = 0;
+	cache->scan = chooseSetScan();
+
+	cache->validWords = (numLines + 63) / 64;
+	cache->validOffset = numLines * sizeof(unsigned long long);
+	cache->dirtyOffset = cache->validOffset + cache->validWords * sizeof(unsigned long long);
+	cache->policyOffset = cache->dirtyOffset + cache->validWords * sizeof(unsigned long long);
+	cache->indexOffset = cache->policyOffset + cache->policy->stateSize(numLines);
+	cache->indexBits = 0;
+	size_t setSize = cache->indexOffset;
+	if (numLines >= INDEX_MIN_LINES) {
+		// Keep the index at most half full, so that probe runs stay short.
+		while ((1LL << cache->indexBits) < 2LL * numLines) {
+			cache->indexBits++;
+		}
+		cache->indexOffset = (cache->indexOffset + sizeof(int) - 1) / sizeof(int) * sizeof(int);
+		setSize = cache->indexOffset + sizeof(struct tagIndex) + (sizeof(int) << cache->indexBits);
+	}
+	cache->setStride = roundToHostLine(setSize);
+
+	if (cache->setStride > SIZE_MAX / cache->numSets) {
+		return -1;
+	}
+	size_t size = cache->setStride * cache->numSets;
+	void *storage;
+	if (posix_memalign(&storage, HOST_LINE_SIZE, size) != 0) {
+		return -1;
+	}
+	cache->storage = storage;
+
+	// Every line starts out invalid. Each set's policy gets its own seed, so that policies with randomness behave the
+	// same no matter how accesses to different sets interleave.
+	memset(cache->storage, 0, size);
+	for (int set = 0; set < cache->numSets; set++) {
+		cache->policy->init(setPolicy(cache, set), numLines, config->seed ^ (set * 0x9E3779B97F4A7C15ULL));
+	}
+	return 0;
+}
+
+void freeCache(struct cache *cache) {
+	free(cache->storage);
+	cache->storage = NULL;
+}
+
+// Return the line of the set holding the block, or -1 if the block is not cached.
+int probeCache(const struct cache *cache, const struct cacheParam *cacheParamPtr) {
+	if (cache->indexBits > 0) {
+		return indexFind(cache, cacheParamPtr->s, cacheParamPtr->tag);
+	}
+	return cache->scan->findTag(setTags(cache, cacheParamPtr->s), setValid(cache, cacheParamPtr->s), cache->numLines,
+			cacheParamPtr->tag);
+}
+
+// Record a use of a cached line, marking it dirty if it was written.
+void touchLine(struct cache *cache, const struct cacheParam *cacheParamPtr, int line, int dirty) {
+	cache->policy->touch(setPolicy(cache, cacheParamPtr->s), cache->numLines, line);
+	if (dirty) {
+		setDirty(cache, cacheParamPtr->s)[line / 64] |= 1ULL << (line % 64);
+	}
+}
+
+// Bring a block that is not cached into its set, using an unused line if there is one and otherwise replacing the line
+// the policy picks. Returns 1 and describes the evicted block through victim if a line had to be replaced.
+int fillCache(struct cache *cache, const struct cacheParam *cacheParamPtr, int dirty, struct cacheVictim *victim) {
+	unsigned long long *tags = setTags(cache, cacheParamPtr->s);
+	unsigned long long *valid = setValid(cache, cacheParamPtr->s);
+	unsigned long long *dirtyBits = setDirty(cache, cacheParamPtr->s);
+	void *policyState = setPolicy(cache, cacheParamPtr->s);
+	int numLines = cache->numLines;
+	int evicted = 0;
+	int line = -1;
+
+	// See if there is an unused line for our value. A full indexed set is known to have none without a scan.
+	int full = cache->indexBits > 0 && setIndex(cache, cacheParamPtr->s)->used == numLines;
+	for (int word = 0; !full && word < cache->validWords; word++) {
+		unsigned long long unused = ~valid[word];
+		if (word == cache->validWords - 1 && numLines % 64 != 0) {
+			unused &= (1ULL << (numLines % 64)) - 1;
+		}
+		if (unused != 0) {
+			line = word * 64 + __builtin_ctzll(unused);
+			break;
+		}
+	}
+
+	// Otherwise let the policy choose the line to evict.
+	if (line < 0) {
+		line = cache->policy->victim(policyState, numLines);
+		evicted = 1;
+		if (victim != NULL) {
+			unsigned long long block = (tags[line] << cache->numSetIndexBits) | cacheParamPtr->s;
+			victim->addr = block << cache->blockSize;
+			victim->dirty = dirtyBits[line / 64] >> (line % 64) & 1;
+		}
+		if (cache->indexBits > 0) {
+			indexRemove(cache, cacheParamPtr->s, line);
+		}
+	}
+
+	unsigned long long bit = 1ULL << (line % 64);
+	tags[line] = cacheParamPtr->tag;
+	if (cache->indexBits > 0) {
+		indexInsert(cache, cacheParamPtr->s, line);
+	}
+	valid[line / 64] |= bit;
+	if (dirty) {
+		dirtyBits[line / 64] |= bit;
+	} else {
+		dirtyBits[line / 64] &= ~bit;
+	}
+	cache->policy->fill(policyState, numLines, line);
+	return evicted;
+}
+
+// Drop a block from the cache if it is there. Returns 1 if it was cached, and whether it was dirty through dirty.
+int invalidateBlock(struct cache *cache, const struct cacheParam *cacheParamPtr, int *dirty) {
+	int line = probeCache(cache, cacheParamPtr);
+	if (line < 0) {
+		return 0;
+	}
+
+	unsigned long long bit = 1ULL << (line % 64);
+	unsigned long long *dirtyBits = setDirty(cache, cacheParamPtr->s);
+	if (dirty != NULL) {
+		*dirty = (dirtyBits[line / 64] & bit) != 0;
+	}
+	dirtyBits[line / 64] &= ~bit;
+	setValid(cache, cacheParamPtr->s)[line / 64] &= ~bit;
+	if (cache->indexBits > 0) {
+		indexRemove(cache, cacheParamPtr->s, line);
+	}
+	cache->policy->invalidate(setPolicy(cache, cacheParamPtr->s), cache->numLines, line);
+	return 1;
+}
+
+// Look the block up in its set. On a miss the block is brought in, replacing the line the policy picks if the set is
+// full. A store of size bytes dirties the line under write-back, or is sent on to memory under write-through. Under
+// no-write-allocate a store miss only goes to memory.
+int accessCache(struct cache *cache, const struct cacheParam *cacheParamPtr, int write, unsigned int size) {
+	int dirty = write && !cache->writeThrough;
+	struct cacheVictim victim;
+
+	if (write && cache->writeThrough) {
+		cache->directWriteBytes += size;
+	}
+
+	// Check to see if the value is already in the cache.
+	int line = probeCache(cache, cacheParamPtr);
+	if (line >= 0) {
+		cache->hits++;
+		touchLine(cache, cacheParamPtr, line, dirty);
+		return CACHE_HIT;
+	}
+	cache->misses++;
+
+	if (write && cache->noWriteAllocate) {
+		if (!cache->writeThrough) {
+			cache->directWriteBytes += size;
+		}
+		return CACHE_MISS;
+	}
+
+	cache->fillBytes += 1ULL << cache->blockSize;
+	if (fillCache(cache, cacheParamPtr, dirty, &victim)) {
+		cache->evictions++;
+		if (victim.dirty) {
+			cache->writebacks++;
+			cache->writebackBytes += 1ULL << cache->blockSize;
+		}
+		return CACHE_MISS | CACHE_EVICTION;
+	}
+	return CACHE_MISS;
+}
+
+// Ask the host to start loading the parts of the set an access will touch: the first tags, the valid and dirty bitmaps,
+// the start of the policy state and the home slot of the tag in the index. A long tag scan continues sequentially,
+// which the host prefetches by itself.
+void prefetchSet(const struct cache *cache, const struct cacheParam *cacheParamPtr) {
+	const char *set = cache->storage + cacheParamPtr->s * cache->setStride;
+
+	__builtin_prefetch(set, 1);
+	__builtin_prefetch(set + cache->validOffset, 1);
+	__builtin_prefetch(set + cache->policyOffset, 1);
+	if (cache->indexBits > 0) {
+		__builtin_prefetch(set + cache->indexOffset + sizeof(struct tagIndex)
+				+ indexSlot(cache, cacheParamPtr->tag) * sizeof(int), 1);
+	}
+}
+
+// Simulate count accesses in order, with the same outcomes and counters as calling accessCache on each. The set of the
+// access PREFETCH_DISTANCE ahead is prefetched before each lookup, so when the cache is far larger than the host's own
+// caches the memory latency of one lookup overlaps with the work on the ones before it.
+void accessCacheBatch(struct cache *cache, const struct cacheParam *params, const unsigned char *writes,
+		const unsigned int *sizes, int count, int *results) {
+	for (int i = 0; i < count && i < PREFETCH_DISTANCE; i++) {
+		prefetchSet(cache, &params[i]);
+	}
+	for (int i = 0; i < count; i++) {
+		if (i + PREFETCH_DISTANCE < count) {
+			prefetchSet(cache, &params[i + PREFETCH_DISTANCE]);
+		}
+		results[i] = accessCache(cache, &params[i], writes[i], sizes[i]);
+	}
+}
+
+// In order to properly parse the memory address, we need to create a mask in which we specify the starting bit and the ending bit.
+static unsigned long long getField(int lowBit, int highBit, unsigned long long memAddr) {
+	int width = highBit - lowBit + 1;
+
+	if (width <= 0 || lowBit >= 64) {
+		return 0;
+	}
+	unsigned long long mask = (width >= 64) ? ~0ULL : (1ULL << width) - 1;
+	return (memAddr >> lowBit) & mask;
+}
+
+// Parse each address and store the correct values in the parameter fields so that we may compare them with those in the cache.
+// Addresses are kept at their full 64 bits, so blocks above 4GiB never alias with blocks below it.
+void parseAddress(const struct cache *cache, unsigned long long memAddr, struct cacheParam *cacheParamPtr) {
+	int tagShift = cache->blockSize + cache->numSetIndexBits;
+	cacheParamPtr->tag = (tagShift >= 64) ? 0 : memAddr >> tagShift;
+	cacheParamPtr->s = getField(cache->blockSize, (cache->numSetIndexBits + cache->blockSize -1), memAddr);
+	cacheParamPtr->b = getField(0, (cache->blockSize -1), memAddr);
+}
@@ -0,0 +1,96 @@
+/*
+ * cache.h - The set associative cache model behind csim
+ *
+ * All state for one simulated cache lives in a struct cache, so any
+ * number of independent caches can be simulated side by side.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include "setscan.h"
+#include "policy.h"
+
+// Split the memory address into the cache fields.
+struct cacheParam {
+	unsigned int s;
+	unsigned long long b;
+	unsigned long long tag;
+};
+
+// Everything needed to build a cache.
+struct cacheConfig {
+	int  numSetIndexBits;
+	int  numLines;
+	int  blockSize;
+	const struct policy *policy;
+	unsigned long long seed;
+	int  writeThrough;          // Stores go straight to memory instead of dirtying the line.
+	int  noWriteAllocate;       // A store miss writes around the cache instead of filling a line.
+};
+
+// Geometry, contents and statistics of one simulated cache.
+//
+// The state of all lines lives in one 64 byte aligned allocation with a fixed stride per set. Each set holds its packed
+// tags, then bitmaps of valid and dirty lines, then the state of the replacement policy, so a lookup scans one contiguous
+// run of tags and never touches the other fields of lines it does not hit.
+//
+// Sets of INDEX_MIN_LINES lines or more, such as those of fully associative caches and large TLBs, also hold an open
+// addressing hash table from tag to line after the policy state, and a count of their valid lines. Lookups, fills and
+// invalidations then take O(1) expected time instead of scanning every line.
+struct cache {
+	int  numSetIndexBits;
+	int  numSets;
+	int  numLines;
+	int  blockSize;
+	const struct policy *policy;
+	int  writeThrough;
+	int  noWriteAllocate;
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evictions;
+	unsigned long long writebacks;  // Evictions of dirty lines.
+	unsigned long long fillBytes;
+	unsigned long long writebackBytes;
+	unsigned long long directWriteBytes;  // Stores sent to memory by write-through or no-write-allocate.
+	size_t setStride;
+	size_t validOffset;
+	size_t dirtyOffset;
+	size_t policyOffset;
+	size_t indexOffset;
+	int  indexBits;             // log2 of the slots in each set's tag index, or 0 if sets are scanned.
+	int  validWords;
+	char *storage;
+	const struct setScan *scan;
+};
+
+// Associativity from which sets get a tag index rather than being scanned.
+#define INDEX_MIN_LINES 64
+
+// Outcome of an access: CACHE_HIT, or CACHE_MISS possibly combined with CACHE_EVICTION.
+#define CACHE_HIT      0
+#define CACHE_MISS     1
+#define CACHE_EVICTION 2
+
+// A block pushed out of the cache to make room for another.
+struct cacheVictim {
+	unsigned long long addr;
+	int dirty;
+};
+
+int createCache(struct cache *cache, const struct cacheConfig *config);
+void freeCache(struct cache *cache);
+void parseAddress(const struct cache *cache, unsigned long long memAddr, struct cacheParam *cacheParamPtr);
+int accessCache(struct cache *cache, const struct cacheParam *cacheParamPtr, int write, unsigned int size);
+void accessCacheBatch(struct cache *cache, const struct cacheParam *params, const unsigned char *writes,
+		const unsigned int *sizes, int count, int *results);
+void prefetchSet(const struct cache *cache, const struct cacheParam *cacheParamPtr);
+
+// Building blocks for models that move blocks between caches, such as a hierarchy. None of them update the counters.
+int probeCache(const struct cache *cache, const struct cacheParam *cacheParamPtr);
+void touchLine(struct cache *cache, const struct cacheParam *cacheParamPtr, int line, int dirty);
+int fillCache(struct cache *cache, const struct cacheParam *cacheParamPtr, int dirty, struct cacheVictim *victim);
+int invalidateBlock(struct cache *cache, const struct cacheParam *cacheParamPtr, int *dirty);
+
+#endif /* CACHE_H */
@@ -1,217 +1,679 @@
 // anrus-rwwittenberg
 
-
 #include "cachelab.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
 #include <unistd.h>
-#include <math.h>
-
-// State information for a cache line.
-struct line {
-	unsigned int tag;
-	int valid;
-	unsigned int timeStamp;
-};
-
-// Split the memory address into the cache fields.
-struct cacheParam {
-	unsigned int s;
-	unsigned int b;
-	unsigned int tag;
-};
+#include <signal.h>
+#include "traceio.h"
+#include "cache.h"
+#include "stackdist.h"
+#include "hierarchy.h"
+#include "parallel.h"
+#include "sampling.h"
+#include "snapshot.h"
+#include "heatmap.h"
+#include "optimal.h"
 
 // Global variables.
 int  numSetIndexBits;
-int  numSets;
 int  numLines;
 int  blockSize;
 int  verbosityFlag = 0;
 char *trace;
-int  hits = 0;
-int  misses = 0;
-int  globalTimeStamp = 0;
-int  evictions = 0;
-char line[256];
-
-struct line **cachePtr;
+char *sweepSpec;
+char *policyName = "lru";
+unsigned long long seed = 1;
+int  writeThrough = 0;
+int  noWriteAllocate = 0;
+int  reportTraffic = 0;
+int  splitAccesses = 0;
+int  sizeHistogram = 0;
+int  numWorkers = 1;
+int  numParsers = 0;
+unsigned long long progressInterval = 0;
+char *samplingSpec;
+char *snapshotFile;
+char *restoreFile;
+unsigned long long recordLimit = 0;
+char *heatmapFile;
+char *regionSpec;
+int  classifyMisses = 0;
+
+// The text of the trace record being simulated, used for verbose output. For text traces it points straight into the
+// mapped trace file and is not NUL terminated.
+const char *record;
+int  recordLength;
+
+// The address of the block access being simulated, used by the heatmap.
+unsigned long long accessAddr;
+
+struct cache cache1;
+
+// With -j the sets of cache1 are simulated by numWorkers threads, while this thread only decodes the trace.
+struct parallelSim parallel1;
+
+// With -m only a sample of the sets or of the trace is simulated, and the results are estimated from it.
+struct sampler sampler1;
+
+// How far into the trace the simulation is. It starts where a restored snapshot left off, and is saved with -k when the
+// simulation ends, reaches the record limit or is interrupted.
+struct tracePosition position1;
+volatile sig_atomic_t stopRequested = 0;
+
+// With -O every access of cache1 is counted per set and per region of the address space.
+struct heatmap heatmap1;
+
+// With -c every miss of cache1 is classified against a fully associative LRU cache of the same capacity, run alongside
+// it as a single set stack distance engine. Its block table doubles as the record of blocks touched before.
+struct stackDist shadow1;
+unsigned long long compulsoryMisses;
+unsigned long long capacityMisses;
+unsigned long long conflictMisses;
+
+// In sweep mode every configuration gets its own cache, all fed from a single pass over the trace.
+struct cache *sweepCaches;
+int  numSweepCaches;
+
+// In curve mode a single stack distance pass yields the results of every associativity from 1 to curveLines.
+int  curveLines;
+struct stackDist curve;
+
+// With -p opt the cache is simulated offline under Belady's optimal policy, after a first pass over the trace.
+int  useOptimal = 0;
+struct optimalCache optimal1;
+
+// In hierarchy mode every access goes through the levels described in hierarchyFile.
+char *hierarchyFile;
+struct hierarchy hierarchy1;
+
+// With -z every access is counted by its size. Sizes from MAX_HISTOGRAM_SIZE up share the last bucket, and an access
+// straddles when it touches more than one block of the simulated cache.
+#define MAX_HISTOGRAM_SIZE 256
+unsigned long long sizeAccesses[MAX_HISTOGRAM_SIZE + 1];
+unsigned long long sizeStraddles[MAX_HISTOGRAM_SIZE + 1];
 
 void printUsage(char *argv[]) {
-	printf("Usage: %s [-hv] -s <num> -E <num> -b <num> -t <file>", argv[0]);
+	printf("Usage: %s [-hvnxz] [-p <policy>] [-r <seed>] [-w <mode>] [-j <num>] [-P <num>] [-g <num>] [-m <spec>]\n"
+			"           [-k <file>] [-K <file>] [-l <num>] [-O <file>] [-R <regions>] [-c] -s <num> -E <num> -b <num> -t <file>\n",
+			argv[0]);
+	printf("       %s [-hnxz] [-p <policy>] [-r <seed>] [-w <mode>] -S <sweep> -t <file>\n", argv[0]);
+	printf("       %s [-hxz] -s <num> -A <num> -b <num> -t <file>\n", argv[0]);
+	printf("       %s [-hxz] [-r <seed>] -H <config> -t <file>\n", argv[0]);
 	printf("Options:\n"
 			"  -h         Print this help message.\n"
 			"  -v         Optional verbose flag.\n"
 			"  -s <num>   Number of set index bits.\n"
 			"  -E <num>   Number of lines per set.\n"
 			"  -b <num>   Number of block offset bits.\n"
-			"  -t <file>  Trace file.\n\n");
+			"  -t <file>  Trace file, either lackey text or trace2bin binary. Use - for stdin.\n"
+			"  -S <sweep> Simulate every combination of the listed s, E and b values.\n"
+			"  -A <num>   Print the LRU miss curve for every E up to <num>.\n"
+			"  -H <file>  Simulate the multi-level write-back hierarchy described in <file>.\n"
+			"  -p <name>  Replacement policy (default lru).\n"
+			"  -r <seed>  Seed for the randomized policies (default 1).\n"
+			"  -w <mode>  Write policy, back or through. Also reports memory traffic.\n"
+			"  -n         Do not allocate lines on store misses. Also reports memory traffic.\n"
+			"  -x         Split accesses that straddle blocks into one access per block touched.\n"
+			"  -z         Print a histogram of the access sizes.\n"
+			"  -j <num>   Simulate the sets of the cache on <num> threads.\n"
+			"  -P <num>   Parse a text trace on <num> threads.\n"
+			"  -g <num>   Report progress on stderr every <num> records.\n"
+			"  -m <spec>  Estimate the results from sets=<ratio>, one in <ratio> sets, or from\n"
+			"             time=<period>,<warmup>,<window>, the last <window> records of every\n"
+			"             <period> after <warmup> records that only warm the cache.\n"
+			"  -k <file>  Save a snapshot of the cache and the trace position when the simulation\n"
+			"             ends, reaches the record limit or is interrupted.\n"
+			"  -K <file>  Restore the cache from a snapshot and resume the trace where it stopped.\n"
+			"             The cache configuration comes from the snapshot, so -s, -E, -b, -p, -r,\n"
+			"             -w, -n and -x cannot be given.\n"
+			"  -l <num>   Stop once <num> records of the trace have been simulated.\n"
+			"  -O <file>  Write hits, misses and evictions per set and per region, as CSV or as\n"
+			"             JSON if <file> ends in .json.\n"
+			"  -R <spec>  Regions for -O, either page=<bits> (default page=12) or a list of\n"
+			"             <name>=<start>-<end> address ranges, named with letters, digits, _, - and .\n"
+			"  -c         Classify misses as compulsory, capacity or conflict misses.\n\n");
+	printf("Policies:\n");
+	listPolicies();
+	printf("  %-8s %s\n", "opt", "Belady's optimal (MIN), needs a trace file it reads twice");
+	printf("\n");
 	printf("Examples:\n"
 			"  linux>  ./csim-ref -s 4 -E 1 -b 4 -t traces/yi.trace\n"
-			"  linux>  ./csim-ref -v -s 8 -E 2 -b 4 -t traces/yi.trace\n");
+			"  linux>  ./csim-ref -v -s 8 -E 2 -b 4 -t traces/yi.trace\n"
+			"  linux>  ./csim -S \"s=1..10,E=1,2,4,8,b=4..6\" -t traces/long.trace\n"
+			"  linux>  ./csim -s 4 -A 64 -b 4 -t traces/long.trace\n"
+			"  linux>  ./csim -p srrip -s 4 -E 8 -b 4 -t traces/long.trace\n"
+			"  linux>  ./csim -p opt -s 4 -E 8 -b 4 -t traces/long.trace\n"
+			"  linux>  ./csim -H hierarchy.cfg -t traces/long.trace\n"
+			"  linux>  ./csim -w through -n -s 4 -E 2 -b 4 -t traces/long.trace\n"
+			"  linux>  ./csim -x -z -s 4 -E 2 -b 4 -t traces/long.trace\n"
+			"  linux>  ./csim -j 4 -P 2 -s 12 -E 16 -b 6 -t traces/long.trace\n"
+			"  linux>  ./csim -l 100000 -k warm.snap -s 10 -E 16 -b 6 -t traces/long.trace\n"
+			"  linux>  ./csim -K warm.snap -t traces/long.trace\n"
+			"  linux>  ./csim -O heat.csv -R A=0x602100-0x602200,B=0x642100-0x642200 -s 5 -E 1 -b 5 -t trace.f0\n"
+			"  linux>  ./csim -c -s 5 -E 1 -b 5 -t traces/trans.trace\n"
+			"  linux>  ./csim -m time=10000,2000,1000 -s 6 -E 4 -b 5 -t traces/long.trace\n"
+			"  linux>  valgrind --tool=lackey --trace-mem=yes ls 2>&1 | ./csim -g 1000000 -s 4 -E 2 -b 4 -t -\n");
 }
 
-// Allocate and initialize the cache.
-void createCache() {
-	cachePtr = malloc(numSets * sizeof(struct line *));
-
-	for (int setIndex = 0; setIndex < numSets; setIndex ++) {
-		cachePtr[setIndex] = malloc(numLines * sizeof(struct line));
+// Classify the outcome of one access: a miss on a block never touched before is compulsory, one that the fully
+// associative cache would also have missed is a capacity miss, and any other is a conflict miss.
+void classifyAccess(int result) {
+	long long distance = accessStackDist(&shadow1, accessAddr);
 
-		for (int lineIndex = 0; lineIndex < numLines; lineIndex++) {
-			cachePtr[setIndex][lineIndex].valid = 0;
-		}
+	if (!(result & CACHE_MISS)) {
+		return;
+	}
+	if (distance == STACKDIST_COLD) {
+		compulsoryMisses++;
+	} else if (distance >= shadow1.maxLines) {
+		capacityMisses++;
+	} else {
+		conflictMisses++;
 	}
 }
 
-// When the trace is prefixed by an "L", then that means to try and load the memory value into the cache.
-void loadOperation(struct cacheParam *cacheParamPtr) {
-	struct line *setPtr = cachePtr[cacheParamPtr->s];
-
-	// Check to see if the value is already in the cache.
-	for (int lines = 0; lines < numLines; lines++) {
-		if (setPtr[lines].valid && setPtr[lines].tag == cacheParamPtr->tag) {
-			hits++;
-			if (verbosityFlag) {
-				printf("%s hit\n", &line[1]);
-			}
-			setPtr[lines].timeStamp = globalTimeStamp;
-			return;
-		}
-	}
-	misses++;
-	if (verbosityFlag) {
-		printf("%s miss\n", &line[1]);
+// Count the outcome of one access in the heatmap and the miss classification, and report it when running verbosely.
+void reportAccess(const struct cacheParam *cacheParamPtr, int result) {
+	if (classifyMisses) {
+		classifyAccess(result);
 	}
-
-	// See if there is an unused line for our value.
-	for (int lines = 0; lines < numLines; lines++) {
-		if (!setPtr[lines].valid) {
-			setPtr[lines].tag = cacheParamPtr->tag;
-			setPtr[lines].timeStamp = globalTimeStamp;
-			setPtr[lines].valid = 1;
-			return;
-		}
+	if (heatmapFile != NULL) {
+		recordHeat(&heatmap1, cacheParamPtr->s, accessAddr, result);
 	}
-
-	struct line *LRU = setPtr;
-	// Find the oldest line and evict it to be replaced with our value.
-	for (int lines = 0; lines < numLines; lines++) {
-		if (setPtr[lines].timeStamp < LRU->timeStamp) {
-			LRU = &setPtr[lines];
-		}
+	if (!verbosityFlag) {
+		return;
 	}
-	LRU->tag = cacheParamPtr->tag;
-	LRU->timeStamp = globalTimeStamp;
-	LRU->valid = 1;
-	evictions++;
-	if (verbosityFlag) {
-		printf("%s eviction\n", &line[1]);
+	printf("%.*s %s\n", recordLength, record, (result & CACHE_MISS) ? "miss" : "hit");
+	if (result & CACHE_EVICTION) {
+		printf("%.*s eviction\n", recordLength, record);
 	}
+}
 
+// When the trace is prefixed by an "L", then that means to try and load the memory value into the cache.
+void loadOperation(struct cacheParam *cacheParamPtr, unsigned int size) {
+	reportAccess(cacheParamPtr, accessCache(&cache1, cacheParamPtr, 0, size));
 }
 
-// In this assignment, load and store behave essentially the same, so we just call load operation, but we are really attempting
-// to store the value in the cache.
-void storeOperation(struct cacheParam *cacheParamPtr) {
-	loadOperation(cacheParamPtr);
+// A store finds or allocates its line the same way a load does, but then dirties it or writes through to memory,
+// depending on the write policy.
+void storeOperation(struct cacheParam *cacheParamPtr, unsigned int size) {
+	reportAccess(cacheParamPtr, accessCache(&cache1, cacheParamPtr, 1, size));
 }
 
-// In this assignment, we are calling both a load and store operation together, so we just call them individually.
-void modifyOperation(struct cacheParam *cacheParamPtr) {
-	loadOperation(cacheParamPtr);
-	storeOperation(cacheParamPtr);
+// A modify is a load followed by a store to the same location. The store always hits the line the load brought in, so
+// it dirties the line without any extra fill traffic.
+void modifyOperation(struct cacheParam *cacheParamPtr, unsigned int size) {
+	loadOperation(cacheParamPtr, size);
+	storeOperation(cacheParamPtr, size);
 }
 
+// The number of bytes of an access of size bytes at addr that fall into the block of 2^b bytes holding addr. Without -x
+// the whole access is charged to that first block, as csim-ref does.
+unsigned int pieceSize(unsigned long long addr, unsigned int size, int b) {
+	if (!splitAccesses) {
+		return size;
+	}
+	unsigned long long room = (1ULL << b) - (addr & ((1ULL << b) - 1));
+	return (size < room) ? size : room;
+}
+
+// Count one record in the size histogram. blockBits is the block size the straddle count is taken against, or -1 when
+// the simulated caches do not share one.
+void countSize(const struct traceRecord *rec, int blockBits) {
+	int bucket = (rec->size < MAX_HISTOGRAM_SIZE) ? rec->size : MAX_HISTOGRAM_SIZE;
+
+	sizeAccesses[bucket]++;
+	if (blockBits >= 0 && rec->size > 0 && ((rec->addr ^ (rec->addr + rec->size - 1)) >> blockBits) != 0) {
+		sizeStraddles[bucket]++;
+	}
+}
 
-// In order to properly parse the memory address, we need to create a mask in which we specify the starting bit and the ending bit.
-unsigned int getField(unsigned lowBit, unsigned highBit, unsigned int memAddr) {
+// Feed one decoded record to every cache of the sweep. A modify is a load followed by a store to the same block.
+void sweepRecord(const struct traceRecord *rec) {
+	struct cacheParam cacheParam1;
 
-	unsigned r = 0;
-	for (unsigned i = lowBit; i <= highBit; i++)
-		r |= 1 << i;
+	for (int config = 0; config < numSweepCaches; config++) {
+		struct cache *cache = &sweepCaches[config];
+		unsigned long long addr = rec->addr;
+		unsigned int left = rec->size;
 
-	unsigned result = r & memAddr;
-	result >>= lowBit;
-	return result;
+		do {
+			unsigned int piece = pieceSize(addr, left, cache->blockSize);
+			parseAddress(cache, addr, &cacheParam1);
+			if (rec->op == 'L' || rec->op == 'M') {
+				accessCache(cache, &cacheParam1, 0, piece);
+			}
+			if (rec->op == 'S' || rec->op == 'M') {
+				accessCache(cache, &cacheParam1, 1, piece);
+			}
+			addr += piece;
+			left -= piece;
+		} while (left > 0);
+	}
 }
 
-// Parse each address and store the correct values in the parameter fields so that we may compare them with those in the cache.
-void parseAddress(unsigned int memAddr, struct cacheParam *cacheParamPtr) {
-	cacheParamPtr->tag = memAddr >> (blockSize + numSetIndexBits);
-	cacheParamPtr->s = getField(blockSize, (numSetIndexBits + blockSize -1), memAddr);
-	cacheParamPtr->b = getField(0, (blockSize -1), memAddr);
+// Send one decoded record through the cache hierarchy, one access per block it touches.
+void hierarchyRecord(const struct traceRecord *rec) {
+	unsigned long long addr = rec->addr;
+	unsigned int left = rec->size;
+
+	do {
+		unsigned int piece = pieceSize(addr, left, hierarchy1.levels[0].blockSize);
+		if (rec->op == 'L' || rec->op == 'M') {
+			accessHierarchy(&hierarchy1, addr, 0);
+		}
+		if (rec->op == 'S' || rec->op == 'M') {
+			accessHierarchy(&hierarchy1, addr, 1);
+		}
+		addr += piece;
+		left -= piece;
+	} while (left > 0);
 }
 
-//  Read the traces from the specified file and run the corresponding operation.
-void runSimulation() {
-	FILE* file;
-	file = fopen(trace, "r");
+// Record the stack distance of every block one decoded record touches.
+void curveRecord(const struct traceRecord *rec) {
+	unsigned long long addr = rec->addr;
+	unsigned int left = rec->size;
 
-	if (file == NULL) {
-		printf("Error could not open file.\n");
-		exit(EXIT_FAILURE);
-	}
+	do {
+		unsigned int piece = pieceSize(addr, left, curve.blockSize);
+		accessStackDist(&curve, addr);
+		if (rec->op == 'M') {
+			accessStackDist(&curve, addr);
+		}
+		addr += piece;
+		left -= piece;
+	} while (left > 0);
+}
 
-	char operation;
-	unsigned int memAddr;
+// Simulate one decoded record on the single cache, one access per block it touches.
+void cacheRecord(const struct traceRecord *rec) {
 	struct cacheParam cacheParam1;
-
-	while (fgets(line, sizeof(line), file)) {
-		if (line[0] == 'I') {
+	unsigned long long addr = rec->addr;
+	unsigned int left = rec->size;
+
+	do {
+		unsigned int piece = pieceSize(addr, left, cache1.blockSize);
+		parseAddress(&cache1, addr, &cacheParam1);
+		accessAddr = addr;
+
+		if (numWorkers > 1) {
+			submitParallel(&parallel1, &cacheParam1, rec->op, piece);
+			addr += piece;
+			left -= piece;
 			continue;
 		}
 
-		strtok(line, "\n");
-		sscanf(line, " %c %X", &operation, &memAddr);
-		parseAddress(memAddr, &cacheParam1);
-
-		switch(operation) {
+		switch(rec->op) {
 
 		case 'L':
-			loadOperation(&cacheParam1);
+			loadOperation(&cacheParam1, piece);
 			break;
 		case 'S':
-			storeOperation(&cacheParam1);
+			storeOperation(&cacheParam1, piece);
 			break;
 		case 'M':
-			modifyOperation(&cacheParam1);
+			modifyOperation(&cacheParam1, piece);
 			break;
-		default:
+		}
+		addr += piece;
+		left -= piece;
+	} while (left > 0);
+}
+
+// Simulate one decoded record under the optimal policy, one block at a time like cacheRecord. Heatmaps are not
+// supported with it, so there is no set to report.
+void optimalRecord(const struct traceRecord *rec) {
+	unsigned long long addr = rec->addr;
+	unsigned int left = rec->size;
+
+	do {
+		unsigned int piece = pieceSize(addr, left, blockSize);
+		reportAccess(NULL, accessOptimal(&optimal1, addr));
+		if (rec->op == 'M') {
+			reportAccess(NULL, accessOptimal(&optimal1, addr));
+		}
+		addr += piece;
+		left -= piece;
+	} while (left > 0);
+}
+
+// Report how far the simulation has got. The running totals are only known while a single cache is simulated serially.
+void printProgress(unsigned long long records) {
+	fprintf(stderr, "progress: %llu records", records);
+	if (useOptimal) {
+		fprintf(stderr, " hits:%llu misses:%llu evictions:%llu", optimal1.hits, optimal1.misses, optimal1.evictions);
+	} else if (sweepCaches == NULL && hierarchyFile == NULL && curveLines == 0 && numWorkers == 1) {
+		fprintf(stderr, " hits:%llu misses:%llu evictions:%llu", cache1.hits, cache1.misses, cache1.evictions);
+	}
+	fprintf(stderr, "\n");
+}
+
+// Simulate one decoded record under sampling. Skipped records and accesses to sets outside the sample are only counted,
+// and only accesses in a measured window reach the sample's counters.
+void sampledRecord(const struct traceRecord *rec) {
+	struct cacheParam cacheParam1;
+	int phase = samplePhase(&sampler1);
+	int loads = (rec->op == 'L' || rec->op == 'M');
+	int stores = (rec->op == 'S' || rec->op == 'M');
+	unsigned long long addr = rec->addr;
+	unsigned int left = rec->size;
+
+	do {
+		unsigned int piece = pieceSize(addr, left, cache1.blockSize);
+		sampler1.totalAccesses += loads + stores;
+		if (phase != SAMPLE_SKIP) {
+			parseAddress(&cache1, addr, &cacheParam1);
+			if (sampleSet(&sampler1, cacheParam1.s)) {
+				for (int write = !loads; write <= stores; write++) {
+					int result = accessCache(&cache1, &cacheParam1, write, piece);
+					if (phase == SAMPLE_MEASURE) {
+						recordSample(&sampler1, cacheParam1.s, result);
+					}
+				}
+			}
+		}
+		addr += piece;
+		left -= piece;
+	} while (left > 0);
+}
+
+//  Read the traces from the specified file and run the corresponding operation. Both lackey text traces and the binary
+//  traces written by trace2bin are accepted, from a file or streamed from stdin or a pipe.
+void runSimulation() {
+	struct traceReader reader;
+	struct traceRecord rec;
+	char text[64];
+	int blockBits = -1;
+
+	if (hierarchyFile != NULL) {
+		blockBits = hierarchy1.levels[0].blockSize;
+	} else if (curveLines > 0) {
+		blockBits = curve.blockSize;
+	} else if (useOptimal) {
+		blockBits = blockSize;
+	} else if (sweepCaches == NULL) {
+		blockBits = cache1.blockSize;
+	}
+
+	openTrace(&reader, trace);
+
+	// Resume a restored simulation, jumping straight to the next record if the trace is mapped.
+	if (position1.records > 0) {
+		if (position1.offset >= 0 && traceOffset(&reader) >= 0) {
+			seekTrace(&reader, position1.offset, position1.lastAddr);
+		} else {
+			for (unsigned long long skipped = 0; skipped < position1.records; skipped++) {
+				if (!readRecord(&reader, &rec)) {
+					printf("Error the trace ends before the position of the snapshot.\n");
+					exit(EXIT_FAILURE);
+				}
+			}
+		}
+	}
+	if (numParsers > 0) {
+		startTraceParsers(&reader, numParsers);
+	}
+
+	while (!stopRequested && (recordLimit == 0 || position1.records < recordLimit) && readRecord(&reader, &rec)) {
+		position1.records++;
+		record = rec.text;
+		recordLength = rec.textLength;
+
+		if (rec.op != 'L' && rec.op != 'S' && rec.op != 'M') {
 			printf("Unknown Operation");
+			continue;
+		}
+		if (sizeHistogram) {
+			countSize(&rec, blockBits);
+		}
+
+		if (sweepCaches != NULL) {
+			sweepRecord(&rec);
+		} else if (hierarchyFile != NULL) {
+			hierarchyRecord(&rec);
+		} else if (curveLines > 0) {
+			curveRecord(&rec);
+		} else {
+			// Binary traces carry no text, so rebuild the record for verbose output.
+			if (record == NULL && verbosityFlag) {
+				recordLength = snprintf(text, sizeof(text), "%c %llx,%u", rec.op, rec.addr, rec.size);
+				record = text;
+			}
+			if (samplingSpec != NULL) {
+				sampledRecord(&rec);
+			} else if (useOptimal) {
+				optimalRecord(&rec);
+			} else {
+				cacheRecord(&rec);
+			}
+		}
+
+		if (progressInterval > 0 && position1.records % progressInterval == 0) {
+			printProgress(position1.records);
+		}
+	}
+
+	position1.offset = traceOffset(&reader);
+	position1.lastAddr = reader.lastAddr;
+	closeTrace(&reader);
+}
+
+// Parse a comma separated list of values such as "1,2,4" or "4..6" into values, stopping at the end of the spec or at the
+// comma that introduces the next parameter. Returns how many values were stored, or -1 if the list is malformed.
+int parseSweepValues(const char **posPtr, int *values, int maxValues) {
+	int count = 0;
+	const char *pos = *posPtr;
+
+	for (;;) {
+		char *next;
+		long low = strtol(pos, &next, 10);
+		long high = low;
+
+		if (next == pos || low < 0) {
+			return -1;
+		}
+		if (strncmp(next, "..", 2) == 0) {
+			pos = next + 2;
+			high = strtol(pos, &next, 10);
+			if (next == pos || high < low) {
+				return -1;
+			}
+		}
+		for (long value = low; value <= high; value++) {
+			if (count == maxValues) {
+				return -1;
+			}
+			values[count++] = value;
+		}
+
+		pos = next;
+		if (*pos != ',' || !(pos[1] >= '0' && pos[1] <= '9')) {
 			break;
 		}
+		pos++;
+	}
 
-		globalTimeStamp++;
+	*posPtr = pos;
+	return count;
+}
+
+// Whether 2^s sets of E lines of 2^b bytes make a cache that can be simulated, by the same rule as csimCreate.
+int validGeometry(int s, int E, int b) {
+	return s >= 0 && s <= 30 && E >= 1 && b >= 0 && s + b <= 64;
+}
+
+// Fill in a cache configuration from the geometry and the policy options.
+void makeConfig(struct cacheConfig *config, int s, int E, int b) {
+	config->numSetIndexBits = s;
+	config->numLines = E;
+	config->blockSize = b;
+	config->policy = findPolicy(policyName);
+	config->seed = seed;
+	config->writeThrough = writeThrough;
+	config->noWriteAllocate = noWriteAllocate;
+}
+
+// Turn a spec such as "s=1..10,E=1,2,4,8,b=4..6" into one cache per combination of s, E and b.
+void createSweep(const char *spec) {
+	int values[3][64];
+	int counts[3] = {0, 0, 0};
+	const char *names = "sEb";
+	const char *pos = spec;
+
+	while (*pos != '\0') {
+		const char *name = strchr(names, *pos);
+		if (*pos == '\0' || name == NULL || pos[1] != '=') {
+			printf("Invalid sweep specification: %s\n", spec);
+			exit(1);
+		}
+
+		pos += 2;
+		counts[name - names] = parseSweepValues(&pos, values[name - names], 64);
+		if (counts[name - names] <= 0 || (*pos != '\0' && *pos++ != ',')) {
+			printf("Invalid sweep specification: %s\n", spec);
+			exit(1);
+		}
+	}
+
+	if (counts[0] == 0 || counts[1] == 0 || counts[2] == 0) {
+		printf("A sweep needs values for s, E and b: %s\n", spec);
+		exit(1);
+	}
+	for (int s = 0; s < counts[0]; s++) {
+		for (int E = 0; E < counts[1]; E++) {
+			for (int b = 0; b < counts[2]; b++) {
+				if (!validGeometry(values[0][s], values[1][E], values[2][b])) {
+					printf("Invalid cache s=%d, E=%d, b=%d in sweep; caches need s <= 30, E >= 1 and s + b <= 64\n",
+							values[0][s], values[1][E], values[2][b]);
+					exit(1);
+				}
+			}
+		}
+	}
+
+	numSweepCaches = counts[0] * counts[1] * counts[2];
+	sweepCaches = malloc(numSweepCaches * sizeof(struct cache));
+
+	int config = 0;
+	for (int s = 0; s < counts[0]; s++) {
+		for (int E = 0; E < counts[1]; E++) {
+			for (int b = 0; b < counts[2]; b++) {
+				struct cacheConfig config1;
+				makeConfig(&config1, values[0][s], values[1][E], values[2][b]);
+				if (createCache(&sweepCaches[config++], &config1) != 0) {
+					printf("Error could not allocate the cache with s=%d, E=%d, b=%d.\n",
+							values[0][s], values[1][E], values[2][b]);
+					exit(EXIT_FAILURE);
+				}
+			}
+		}
+	}
+}
 
+// Print one row of hits, misses and evictions per configuration of the sweep, plus memory traffic if asked for.
+void printSweep() {
+	printf("%4s %6s %4s %12s %12s %12s", "s", "E", "b", "hits", "misses", "evictions");
+	if (reportTraffic) {
+		printf(" %12s %14s %14s %14s", "dirty evicts", "fill bytes", "wb bytes", "direct bytes");
+	}
+	printf("\n");
+	for (int config = 0; config < numSweepCaches; config++) {
+		struct cache *cache = &sweepCaches[config];
+		printf("%4d %6d %4d %12llu %12llu %12llu", cache->numSetIndexBits, cache->numLines, cache->blockSize,
+				cache->hits, cache->misses, cache->evictions);
+		if (reportTraffic) {
+			printf(" %12llu %14llu %14llu %14llu", cache->writebacks, cache->fillBytes, cache->writebackBytes,
+					cache->directWriteBytes);
+		}
+		printf("\n");
 	}
+}
 
-	fclose(file);
+// Print the memory traffic the write policy produced.
+void printTraffic(const struct cache *cache) {
+	printf("dirty evictions:%llu fill bytes:%llu writeback bytes:%llu direct write bytes:%llu\n", cache->writebacks,
+			cache->fillBytes, cache->writebackBytes, cache->directWriteBytes);
 }
 
+// Print how many accesses of each size the trace made, and how many of them straddled a block boundary.
+void printSizeHistogram(int blockBits) {
+	unsigned long long total = 0;
+
+	for (int size = 0; size <= MAX_HISTOGRAM_SIZE; size++) {
+		total += sizeAccesses[size];
+	}
+
+	printf("%6s %12s %8s", "size", "accesses", "share");
+	if (blockBits >= 0) {
+		printf(" %12s", "straddling");
+	}
+	printf("\n");
+	for (int size = 0; size <= MAX_HISTOGRAM_SIZE; size++) {
+		if (sizeAccesses[size] == 0) {
+			continue;
+		}
+		if (size == MAX_HISTOGRAM_SIZE) {
+			printf("%5d+", size);
+		} else {
+			printf("%6d", size);
+		}
+		printf(" %12llu %7.2f%%", sizeAccesses[size], 100.0 * sizeAccesses[size] / total);
+		if (blockBits >= 0) {
+			printf(" %12llu", sizeStraddles[size]);
+		}
+		printf("\n");
+	}
+}
 
 struct memBlock {
 	int timeStamp;
 	int startEndAddr;
 };
 
+// Print the hits, misses, evictions and miss ratio of every associativity from 1 to curveLines.
+void printCurve() {
+	printf("%6s %12s %12s %12s %10s\n", "E", "hits", "misses", "evictions", "miss ratio");
+	for (int E = 1; E <= curveLines; E++) {
+		unsigned long long hits, misses, evictions;
+		stackDistResults(&curve, E, &hits, &misses, &evictions);
+		printf("%6d %12llu %12llu %12llu %10.6f\n", E, hits, misses, evictions,
+				curve.accesses ? (double)misses / curve.accesses : 0.0);
+	}
+}
+
+// Ask the simulation to stop at the next record, so that its snapshot can be saved. A second signal is fatal.
+void requestStop(int sig) {
+	stopRequested = 1;
+	signal(sig, SIG_DFL);
+}
+
 // Read the command line arguments and assign the appropriate variables.
 void getArgs(int argc, char *argv[]) {
 	int opt;
+	int cacheOptions = 0;       // Whether any option describing the cache was given, which -K must not get.
+	int levelOptions = 0;       // Whether any option describing a single level was given, which -H must not get.
 	if (argc == 1) {
 		printf("Missing required command line argument\n ");
 		printUsage(argv);
 		exit(1);
 	}
 
-	while ((opt = getopt (argc, argv, "s:E:b:t:vh")) != -1) {
+	while ((opt = getopt (argc, argv, "s:E:b:t:S:A:H:p:r:w:j:P:g:m:k:K:l:O:R:cnxzvh")) != -1) {
 
+		if (strchr("sEbprwnx", opt) != NULL) {
+			cacheOptions = 1;
+		}
+		if (strchr("sEbpwn", opt) != NULL) {
+			levelOptions = 1;
+		}
 		switch (opt) {
 
 		case 's':
 			numSetIndexBits = atoi(optarg);
-			numSets = (int)pow((double)2, numSetIndexBits);
 			break;
 		case 'E':
 			numLines = atoi(optarg);
@@ -222,6 +684,84 @@ void getArgs(int argc, char *argv[]) {
 		case 't':
 			trace = optarg;
 			break;
+		case 'S':
+			sweepSpec = optarg;
+			break;
+		case 'A':
+			curveLines = atoi(optarg);
+			break;
+		case 'H':
+			hierarchyFile = optarg;
+			break;
+		case 'p':
+			policyName = optarg;
+			break;
+		case 'r':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'w':
+			if (strcmp(optarg, "back") == 0) {
+				writeThrough = 0;
+			} else if (strcmp(optarg, "through") == 0) {
+				writeThrough = 1;
+			} else {
+				printf("The write policy must be back or through\n");
+				exit(1);
+			}
+			reportTraffic = 1;
+			break;
+		case 'n':
+			noWriteAllocate = 1;
+			reportTraffic = 1;
+			break;
+		case 'j':
+			numWorkers = atoi(optarg);
+			if (numWorkers < 1) {
+				printf("The number of threads must be at least 1\n");
+				exit(1);
+			}
+			break;
+		case 'P':
+			numParsers = atoi(optarg);
+			if (numParsers < 1) {
+				printf("The number of parser threads must be at least 1\n");
+				exit(1);
+			}
+			break;
+		case 'g':
+			progressInterval = strtoull(optarg, NULL, 0);
+			break;
+		case 'm':
+			samplingSpec = optarg;
+			if (parseSampling(&sampler1, samplingSpec) < 0) {
+				printf("Invalid sampling specification: %s\n", samplingSpec);
+				exit(1);
+			}
+			break;
+		case 'k':
+			snapshotFile = optarg;
+			break;
+		case 'K':
+			restoreFile = optarg;
+			break;
+		case 'l':
+			recordLimit = strtoull(optarg, NULL, 0);
+			break;
+		case 'O':
+			heatmapFile = optarg;
+			break;
+		case 'R':
+			regionSpec = optarg;
+			break;
+		case 'c':
+			classifyMisses = 1;
+			break;
+		case 'x':
+			splitAccesses = 1;
+			break;
+		case 'z':
+			sizeHistogram = 1;
+			break;
 		case 'v':
 			verbosityFlag = 1;
 			break;
@@ -231,6 +771,66 @@ void getArgs(int argc, char *argv[]) {
 			exit(0);
 		}
 	}
+
+	if (restoreFile != NULL && cacheOptions) {
+		printf("-K restores the cache of the snapshot, so -s, -E, -b, -p, -r, -w, -n and -x cannot be given\n");
+		exit(1);
+	}
+	if (hierarchyFile != NULL && levelOptions) {
+		printf("The levels of -H come from its file and write back, so -s, -E, -b, -p, -w and -n cannot be given\n");
+		exit(1);
+	}
+	useOptimal = strcmp(policyName, "opt") == 0;
+	if (useOptimal && (sweepSpec != NULL || curveLines > 0 || hierarchyFile != NULL || numWorkers > 1
+			|| samplingSpec != NULL || snapshotFile != NULL || restoreFile != NULL || recordLimit > 0
+			|| heatmapFile != NULL || classifyMisses || reportTraffic)) {
+		printf("The optimal policy needs a single write-back cache, serial simulation and none of -m, -k, -K, -l, -O or -c\n");
+		exit(1);
+	}
+	if (!useOptimal && findPolicy(policyName) == NULL) {
+		printf("Unknown replacement policy %s\n", policyName);
+		printUsage(argv);
+		exit(1);
+	}
+	if (curveLines > 0 && strcmp(policyName, "lru") != 0) {
+		printf("Miss curves can only be computed for LRU\n");
+		exit(1);
+	}
+	if (numWorkers > 1 && (verbosityFlag || sweepSpec != NULL || curveLines > 0 || hierarchyFile != NULL)) {
+		printf("Parallel simulation needs a single cache and no verbose output\n");
+		exit(1);
+	}
+	if (samplingSpec != NULL && (verbosityFlag || numWorkers > 1 || sweepSpec != NULL || curveLines > 0
+			|| hierarchyFile != NULL)) {
+		printf("Sampling needs a single cache, serial simulation and no verbose output\n");
+		exit(1);
+	}
+	if ((snapshotFile != NULL || restoreFile != NULL || recordLimit > 0) && (samplingSpec != NULL || sweepSpec != NULL
+			|| curveLines > 0 || hierarchyFile != NULL)) {
+		printf("Snapshots and record limits need a single cache without sampling\n");
+		exit(1);
+	}
+	if (heatmapFile != NULL && (numWorkers > 1 || samplingSpec != NULL || sweepSpec != NULL || curveLines > 0
+			|| hierarchyFile != NULL)) {
+		printf("Heatmaps need a single cache, serial simulation and no sampling\n");
+		exit(1);
+	}
+	if (classifyMisses && (numWorkers > 1 || samplingSpec != NULL || sweepSpec != NULL || curveLines > 0
+			|| hierarchyFile != NULL || restoreFile != NULL)) {
+		printf("Miss classification needs a single fresh cache, serial simulation and no sampling\n");
+		exit(1);
+	}
+	// The miss curve takes its lines from -A, the other modes their whole geometry from elsewhere.
+	if (sweepSpec == NULL && hierarchyFile == NULL && restoreFile == NULL
+			&& !validGeometry(numSetIndexBits, (curveLines > 0) ? 1 : numLines, blockSize)) {
+		printf("The cache needs 0 <= s <= 30, E >= 1, b >= 0 and s + b <= 64\n");
+		printUsage(argv);
+		exit(1);
+	}
+	if (parseRegions(&heatmap1, regionSpec) < 0) {
+		printf("Invalid region specification: %s\n", regionSpec);
+		exit(1);
+	}
 }
 
 // Call our functions to read the arguments, create the cache, and run the simulation using the designated trace file.
@@ -238,12 +838,113 @@ int main(int argc, char *argv[]) {
 
 	getArgs(argc, argv);
 
-	createCache(numSetIndexBits, numLines, blockSize);
+	if (sweepSpec != NULL) {
+		createSweep(sweepSpec);
+		runSimulation();
+		if (sizeHistogram) {
+			printSizeHistogram(-1);
+		}
+		printSweep();
+		return 0;
+	}
+
+	if (hierarchyFile != NULL) {
+		loadHierarchy(&hierarchy1, hierarchyFile, seed);
+		runSimulation();
+		if (sizeHistogram) {
+			printSizeHistogram(hierarchy1.levels[0].blockSize);
+		}
+		printHierarchy(&hierarchy1);
+		printSummary(hierarchy1.levels[0].hits, hierarchy1.levels[0].misses, hierarchy1.levels[0].evictions);
+		return 0;
+	}
 
+	if (curveLines > 0) {
+		createStackDist(&curve, numSetIndexBits, blockSize, curveLines);
+		runSimulation();
+		if (sizeHistogram) {
+			printSizeHistogram(curve.blockSize);
+		}
+		printCurve();
+		return 0;
+	}
+
+	if (useOptimal) {
+		createOptimal(&optimal1, numSetIndexBits, numLines, blockSize, splitAccesses);
+		indexNextUses(&optimal1, trace, numParsers);
+		runSimulation();
+		if (sizeHistogram) {
+			printSizeHistogram(blockSize);
+		}
+		printSummary(optimal1.hits, optimal1.misses, optimal1.evictions);
+		return 0;
+	}
+
+	if (restoreFile != NULL) {
+		loadSnapshot(restoreFile, &cache1, &splitAccesses, &position1);
+	} else {
+		struct cacheConfig config1;
+		makeConfig(&config1, numSetIndexBits, numLines, blockSize);
+		if (createCache(&cache1, &config1) != 0) {
+			printf("Error could not allocate the cache.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (snapshotFile != NULL) {
+		signal(SIGINT, requestStop);
+		signal(SIGTERM, requestStop);
+	}
+
+	if (numWorkers > 1) {
+		startParallel(&parallel1, &cache1, numWorkers);
+	}
+	if (samplingSpec != NULL) {
+		startSampling(&sampler1, cache1.numSetIndexBits);
+	}
+	if (heatmapFile != NULL) {
+		createHeatmap(&heatmap1, cache1.numSetIndexBits);
+	}
+	if (classifyMisses) {
+		createStackDist(&shadow1, 0, cache1.blockSize, cache1.numSets * cache1.numLines);
+	}
 	runSimulation();
+	if (numWorkers > 1) {
+		finishParallel(&parallel1);
+	}
+
+	if (samplingSpec != NULL) {
+		unsigned long long hits, misses, evictions;
+		finishSampling(&sampler1);
+		if (sizeHistogram) {
+			printSizeHistogram(cache1.blockSize);
+		}
+		printSampling(&sampler1, &hits, &misses, &evictions);
+		printSummary(hits, misses, evictions);
+		return 0;
+	}
+
+	if (heatmapFile != NULL) {
+		writeHeatmap(&heatmap1, heatmapFile);
+	}
+	if (classifyMisses) {
+		printf("compulsory:%llu capacity:%llu conflict:%llu\n", compulsoryMisses, capacityMisses, conflictMisses);
+	}
+	if (stopRequested) {
+		printf("interrupted after %llu records\n", position1.records);
+	}
+	if (snapshotFile != NULL) {
+		saveSnapshot(snapshotFile, &cache1, splitAccesses, &position1);
+		printf("snapshot of %llu records saved to %s\n", position1.records, snapshotFile);
+	}
 
 	// We could free the cache memory here, but exiting will free all the memory anyway.
 
-	printSummary(hits, misses, evictions);
+	if (sizeHistogram) {
+		printSizeHistogram(cache1.blockSize);
+	}
+	if (reportTraffic) {
+		printTraffic(&cache1);
+	}
+	printSummary(cache1.hits, cache1.misses, cache1.evictions);
 	return 0;
 }
@@ -0,0 +1,280 @@
+/*
+ * heatmap.c - Per set and per address region counters
+ */
+
+#include "heatmap.h"
+#include "cache.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_PAGE_BITS 12
+
+static int compareRegions(const void *a, const void *b) {
+	const struct heatRegion *left = a;
+	const struct heatRegion *right = b;
+	return (left->start > right->start) - (left->start < right->start);
+}
+
+// Parse "page=<bits>" or a comma separated list of "<name>=<start>-<end>" ranges, which must not overlap. Names are
+// made of letters, digits, '_', '-' and '.', so they need no quoting in CSV or JSON. Returns 0 on success and -1 if
+// the spec is malformed.
+int parseRegions(struct heatmap *heatmap, const char *spec) {
+	const char *pos = spec;
+	char *next;
+
+	memset(heatmap, 0, sizeof(*heatmap));
+	heatmap->pageBits = DEFAULT_PAGE_BITS;
+	if (spec == NULL) {
+		return 0;
+	}
+
+	if (strncmp(spec, "page=", 5) == 0) {
+		long bits = strtol(spec + 5, &next, 10);
+		if (next == spec + 5 || *next != '\0' || bits < 0 || bits > 40) {
+			return -1;
+		}
+		heatmap->pageBits = bits;
+		return 0;
+	}
+
+	heatmap->pageBits = -1;
+	while (*pos != '\0') {
+		const char *equals = strchr(pos, '=');
+		if (equals == NULL || equals == pos || equals - pos >= MAX_REGION_NAME) {
+			return -1;
+		}
+
+		heatmap->regions = realloc(heatmap->regions, (heatmap->numRegions + 1) * sizeof(struct heatRegion));
+		struct heatRegion *region = &heatmap->regions[heatmap->numRegions++];
+		memset(region, 0, sizeof(*region));
+		memcpy(region->name, pos, equals - pos);
+		for (const char *c = region->name; *c != '\0'; c++) {
+			if (!isalnum((unsigned char) *c) && *c != '_' && *c != '-' && *c != '.') {
+				return -1;
+			}
+		}
+
+		region->start = strtoull(equals + 1, &next, 0);
+		if (next == equals + 1 || *next != '-') {
+			return -1;
+		}
+		pos = next + 1;
+		region->end = strtoull(pos, &next, 0);
+		if (next == pos || region->end <= region->start || (*next != ',' && *next != '\0')) {
+			return -1;
+		}
+		pos = (*next == ',') ? next + 1 : next;
+	}
+	if (heatmap->numRegions == 0) {
+		return -1;
+	}
+
+	qsort(heatmap->regions, heatmap->numRegions, sizeof(struct heatRegion), compareRegions);
+	for (unsigned long long i = 1; i < heatmap->numRegions; i++) {
+		if (heatmap->regions[i].start < heatmap->regions[i - 1].end) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// Allocate the per set counters, and the page table if regions are pages.
+void createHeatmap(struct heatmap *heatmap, int numSetIndexBits) {
+	heatmap->numSets = 1 << numSetIndexBits;
+	heatmap->sets = calloc(heatmap->numSets, sizeof(struct heatCounts));
+	if (heatmap->pageBits >= 0) {
+		heatmap->tableSize = 1024;
+		heatmap->regions = calloc(heatmap->tableSize, sizeof(struct heatRegion));
+	}
+	if (heatmap->sets == NULL || heatmap->regions == NULL) {
+		printf("Error could not allocate the heatmap.\n");
+		exit(EXIT_FAILURE);
+	}
+	snprintf(heatmap->other.name, MAX_REGION_NAME, "other");
+}
+
+static unsigned long long hashPage(unsigned long long page) {
+	page ^= page >> 33;
+	page *= 0xFF51AFD7ED558CCDULL;
+	return page ^ (page >> 33);
+}
+
+// Find the entry of the page in the table, claiming an empty one for a page seen for the first time. An entry is empty
+// while it has no name, as the end of the topmost page wraps to 0.
+static struct heatRegion *findPage(struct heatmap *heatmap, unsigned long long page) {
+	unsigned long long mask = heatmap->tableSize - 1;
+	unsigned long long slot = hashPage(page) & mask;
+
+	while (heatmap->regions[slot].name[0] != '\0') {
+		if (heatmap->regions[slot].start >> heatmap->pageBits == page) {
+			return &heatmap->regions[slot];
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	// Keep the table at most half full, so that probe sequences stay short.
+	if (2 * (heatmap->numRegions + 1) > heatmap->tableSize) {
+		struct heatRegion *old = heatmap->regions;
+		unsigned long long oldSize = heatmap->tableSize;
+
+		heatmap->tableSize *= 2;
+		heatmap->regions = calloc(heatmap->tableSize, sizeof(struct heatRegion));
+		if (heatmap->regions == NULL) {
+			printf("Error could not allocate the heatmap.\n");
+			exit(EXIT_FAILURE);
+		}
+		mask = heatmap->tableSize - 1;
+		for (unsigned long long i = 0; i < oldSize; i++) {
+			if (old[i].name[0] != '\0') {
+				slot = hashPage(old[i].start >> heatmap->pageBits) & mask;
+				while (heatmap->regions[slot].name[0] != '\0') {
+					slot = (slot + 1) & mask;
+				}
+				heatmap->regions[slot] = old[i];
+			}
+		}
+		free(old);
+
+		slot = hashPage(page) & mask;
+		while (heatmap->regions[slot].name[0] != '\0') {
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	struct heatRegion *region = &heatmap->regions[slot];
+	region->start = page << heatmap->pageBits;
+	region->end = region->start + (1ULL << heatmap->pageBits);
+	snprintf(region->name, MAX_REGION_NAME, "page");
+	heatmap->numRegions++;
+	return region;
+}
+
+// Find the named range holding addr, or the catch all region.
+static struct heatRegion *findRange(struct heatmap *heatmap, unsigned long long addr) {
+	unsigned long long low = 0;
+	unsigned long long high = heatmap->numRegions;
+
+	while (low < high) {
+		unsigned long long middle = (low + high) / 2;
+		if (heatmap->regions[middle].end <= addr) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	if (low < heatmap->numRegions && heatmap->regions[low].start <= addr) {
+		return &heatmap->regions[low];
+	}
+	return &heatmap->other;
+}
+
+static void countResult(struct heatCounts *counts, int result) {
+	if (result & CACHE_MISS) {
+		counts->misses++;
+	} else {
+		counts->hits++;
+	}
+	if (result & CACHE_EVICTION) {
+		counts->evictions++;
+	}
+}
+
+// Count the outcome of one access to addr, which maps to the set.
+void recordHeat(struct heatmap *heatmap, unsigned int set, unsigned long long addr, int result) {
+	struct heatRegion *region;
+
+	countResult(&heatmap->sets[set], result);
+	if (heatmap->pageBits >= 0) {
+		region = findPage(heatmap, addr >> heatmap->pageBits);
+	} else {
+		region = findRange(heatmap, addr);
+	}
+	countResult(&region->counts, result);
+}
+
+// Write the end of the region in hex. Only the topmost page can end at 2^64, which is kept as 0.
+static void formatEnd(char *text, size_t size, const struct heatRegion *region) {
+	if (region->end == 0) {
+		snprintf(text, size, "0x10000000000000000");
+	} else {
+		snprintf(text, size, "0x%llx", region->end);
+	}
+}
+
+// Write every set, then every region in address order, as CSV rows or JSON objects.
+void writeHeatmap(const struct heatmap *heatmap, const char *path) {
+	size_t length = strlen(path);
+	int json = length >= 5 && strcmp(path + length - 5, ".json") == 0;
+	unsigned long long numRegions = 0;
+	struct heatRegion *regions = malloc((heatmap->numRegions + 1) * sizeof(struct heatRegion));
+
+	FILE *file = fopen(path, "w");
+	if (file == NULL || regions == NULL) {
+		printf("Error could not create %s.\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	// Collect the used pages, or the named ranges and the catch all region if it was ever hit.
+	if (heatmap->pageBits >= 0) {
+		for (unsigned long long slot = 0; slot < heatmap->tableSize; slot++) {
+			if (heatmap->regions[slot].name[0] != '\0') {
+				regions[numRegions++] = heatmap->regions[slot];
+			}
+		}
+		qsort(regions, numRegions, sizeof(struct heatRegion), compareRegions);
+	} else {
+		memcpy(regions, heatmap->regions, heatmap->numRegions * sizeof(struct heatRegion));
+		numRegions = heatmap->numRegions;
+		const struct heatCounts *other = &heatmap->other.counts;
+		if (other->hits + other->misses > 0) {
+			regions[numRegions++] = heatmap->other;
+		}
+	}
+
+	if (json) {
+		fprintf(file, "{\n  \"sets\": [\n");
+	} else {
+		fprintf(file, "kind,name,start,end,hits,misses,evictions\n");
+	}
+	for (int set = 0; set < heatmap->numSets; set++) {
+		const struct heatCounts *counts = &heatmap->sets[set];
+		if (json) {
+			fprintf(file, "    {\"set\": %d, \"hits\": %llu, \"misses\": %llu, \"evictions\": %llu}%s\n", set,
+					counts->hits, counts->misses, counts->evictions, set + 1 < heatmap->numSets ? "," : "");
+		} else {
+			fprintf(file, "set,%d,,,%llu,%llu,%llu\n", set, counts->hits, counts->misses, counts->evictions);
+		}
+	}
+
+	if (json) {
+		fprintf(file, "  ],\n  \"regions\": [\n");
+	}
+	for (unsigned long long i = 0; i < numRegions; i++) {
+		const struct heatRegion *region = &regions[i];
+		int other = heatmap->pageBits < 0 && i == heatmap->numRegions;
+		char end[24];
+		formatEnd(end, sizeof(end), region);
+		if (json) {
+			fprintf(file, "    {\"name\": \"%s\", ", region->name);
+			if (!other) {
+				fprintf(file, "\"start\": \"0x%llx\", \"end\": \"%s\", ", region->start, end);
+			}
+			fprintf(file, "\"hits\": %llu, \"misses\": %llu, \"evictions\": %llu}%s\n", region->counts.hits,
+					region->counts.misses, region->counts.evictions, i + 1 < numRegions ? "," : "");
+		} else if (other) {
+			fprintf(file, "region,%s,,,%llu,%llu,%llu\n", region->name, region->counts.hits, region->counts.misses,
+					region->counts.evictions);
+		} else {
+			fprintf(file, "region,%s,0x%llx,%s,%llu,%llu,%llu\n", region->name, region->start, end,
+					region->counts.hits, region->counts.misses, region->counts.evictions);
+		}
+	}
+	if (json) {
+		fprintf(file, "  ]\n}\n");
+	}
+
+	fclose(file);
+	free(regions);
+}
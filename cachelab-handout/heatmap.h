@@ -0,0 +1,49 @@
+/*
+ * heatmap.h - Per set and per address region counters
+ *
+ * To find out which sets a workload thrashes and which of its data
+ * structures are to blame, the outcome of every access can be counted
+ * per set and per address region. Regions are either every page of
+ * 2^pageBits bytes the trace touches, or a list of named address
+ * ranges such as "A=0x602000-0x606000,B=0x606000-0x60a000", with the
+ * accesses outside all of them counted as "other". The counters are
+ * written as CSV, or as JSON if the file name ends in .json.
+ */
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#define MAX_REGION_NAME 32
+
+struct heatCounts {
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evictions;
+};
+
+// A named address range [start, end), or a page when regions are pages. The end of the topmost page is 0.
+struct heatRegion {
+	unsigned long long start;
+	unsigned long long end;
+	char name[MAX_REGION_NAME];
+	struct heatCounts counts;
+};
+
+struct heatmap {
+	int numSets;
+	struct heatCounts *sets;
+
+	// Page regions live in an open addressing hash table keyed by page number; named ranges in an array sorted by start.
+	int pageBits;               // -1 when regions are named ranges.
+	struct heatRegion *regions;
+	unsigned long long numRegions;
+	unsigned long long tableSize;
+	struct heatRegion other;
+};
+
+int parseRegions(struct heatmap *heatmap, const char *spec);
+void createHeatmap(struct heatmap *heatmap, int numSetIndexBits);
+void recordHeat(struct heatmap *heatmap, unsigned int set, unsigned long long addr, int result);
+void writeHeatmap(const struct heatmap *heatmap, const char *path);
+
+#endif /* HEATMAP_H */
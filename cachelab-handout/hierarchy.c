@@ -0,0 +1,217 @@
+/*
+ * hierarchy.c - A multi-level cache hierarchy built from the cache model
+ */
+
+#include "hierarchy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *inclusionNames[] = { "nine", "inclusive", "exclusive" };
+
+static void configError(const char *path, int lineNumber, const char *message) {
+	printf("%s:%d: %s\n", path, lineNumber, message);
+	exit(1);
+}
+
+// Read the hierarchy description and build one cache per level.
+void loadHierarchy(struct hierarchy *hier, const char *path, unsigned long long seed) {
+	FILE *file = fopen(path, "r");
+	char buf[256];
+	int lineNumber = 0;
+
+	if (file == NULL) {
+		printf("Error could not open hierarchy file %s.\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	memset(hier, 0, sizeof(*hier));
+	while (fgets(buf, sizeof(buf), file)) {
+		lineNumber++;
+		char *comment = strchr(buf, '#');
+		if (comment != NULL) {
+			*comment = '\0';
+		}
+
+		char *token = strtok(buf, " \t\r\n");
+		if (token == NULL) {
+			continue;
+		}
+		if (hier->numLevels == MAX_LEVELS) {
+			configError(path, lineNumber, "too many levels");
+		}
+
+		int level = hier->numLevels;
+		struct cacheConfig config = { -1, -1, -1, findPolicy("lru"), seed + level };
+		snprintf(hier->names[level], sizeof(hier->names[level]), "%s", token);
+		hier->inclusion[level] = INCLUSION_NINE;
+
+		while ((token = strtok(NULL, " \t\r\n")) != NULL) {
+			char *value = strchr(token, '=');
+			if (value == NULL) {
+				configError(path, lineNumber, "expected key=value");
+			}
+			*value++ = '\0';
+
+			if (strcmp(token, "s") == 0) {
+				config.numSetIndexBits = atoi(value);
+			} else if (strcmp(token, "E") == 0) {
+				config.numLines = atoi(value);
+			} else if (strcmp(token, "b") == 0) {
+				config.blockSize = atoi(value);
+			} else if (strcmp(token, "policy") == 0) {
+				config.policy = findPolicy(value);
+				if (config.policy == NULL) {
+					configError(path, lineNumber, "unknown replacement policy");
+				}
+			} else if (strcmp(token, "inclusion") == 0) {
+				int found = -1;
+				for (int i = 0; i < 3; i++) {
+					if (strcmp(value, inclusionNames[i]) == 0) {
+						found = i;
+					}
+				}
+				if (found < 0) {
+					configError(path, lineNumber, "inclusion must be inclusive, exclusive or nine");
+				}
+				hier->inclusion[level] = found;
+			} else {
+				configError(path, lineNumber, "unknown key");
+			}
+		}
+
+		if (config.numSetIndexBits < 0 || config.numLines <= 0 || config.blockSize <= 0) {
+			configError(path, lineNumber, "every level needs s, E and b");
+		}
+		if (level > 0 && config.blockSize != hier->levels[0].blockSize) {
+			configError(path, lineNumber, "all levels must use the same block size");
+		}
+
+		if (createCache(&hier->levels[level], &config) != 0) {
+			printf("Error could not allocate level %s of %s.\n", hier->names[level], path);
+			exit(EXIT_FAILURE);
+		}
+		hier->numLevels++;
+	}
+	fclose(file);
+
+	if (hier->numLevels == 0) {
+		printf("Error %s describes no cache levels.\n", path);
+		exit(1);
+	}
+}
+
+static void fillLevel(struct hierarchy *hier, int level, unsigned long long memAddr, int dirty);
+
+// Write a dirty block back into a level, allocating it there if it is not present. Past the last level it goes to memory.
+static void writeBack(struct hierarchy *hier, int level, unsigned long long memAddr) {
+	if (level == hier->numLevels) {
+		hier->memoryWrites++;
+		return;
+	}
+
+	struct cache *cache = &hier->levels[level];
+	struct cacheParam cacheParam1;
+	parseAddress(cache, memAddr, &cacheParam1);
+
+	int line = probeCache(cache, &cacheParam1);
+	if (line >= 0) {
+		touchLine(cache, &cacheParam1, line, 1);
+	} else {
+		fillLevel(hier, level, memAddr, 1);
+	}
+}
+
+// Deal with a block a level evicted: invalidate the copies above an inclusive level, then either move the block into an
+// exclusive level below or write it back if it is dirty.
+static void evictFromLevel(struct hierarchy *hier, int level, const struct cacheVictim *victim) {
+	int dirty = victim->dirty;
+
+	hier->levels[level].evictions++;
+
+	if (hier->inclusion[level] == INCLUSION_INCLUSIVE) {
+		for (int above = 0; above < level; above++) {
+			struct cacheParam cacheParam1;
+			int aboveDirty = 0;
+			parseAddress(&hier->levels[above], victim->addr, &cacheParam1);
+			if (invalidateBlock(&hier->levels[above], &cacheParam1, &aboveDirty) && aboveDirty) {
+				dirty = 1;
+			}
+		}
+	}
+
+	if (dirty) {
+		hier->levels[level].writebacks++;
+	}
+
+	if (level + 1 < hier->numLevels && hier->inclusion[level + 1] == INCLUSION_EXCLUSIVE) {
+		fillLevel(hier, level + 1, victim->addr, dirty);
+	} else if (dirty) {
+		writeBack(hier, level + 1, victim->addr);
+	}
+}
+
+static void fillLevel(struct hierarchy *hier, int level, unsigned long long memAddr, int dirty) {
+	struct cache *cache = &hier->levels[level];
+	struct cacheParam cacheParam1;
+	struct cacheVictim victim;
+
+	parseAddress(cache, memAddr, &cacheParam1);
+	if (fillCache(cache, &cacheParam1, dirty, &victim)) {
+		evictFromLevel(hier, level, &victim);
+	}
+}
+
+// Demand access to a level on behalf of the level above, or the processor for level 0. Returns whether the block that
+// comes back is dirty, which only happens when it moves up out of an exclusive level.
+static int fetchBlock(struct hierarchy *hier, int level, unsigned long long memAddr, int write) {
+	if (level == hier->numLevels) {
+		hier->memoryReads++;
+		return 0;
+	}
+
+	struct cache *cache = &hier->levels[level];
+	struct cacheParam cacheParam1;
+	int exclusive = level > 0 && hier->inclusion[level] == INCLUSION_EXCLUSIVE;
+	int dirty = 0;
+
+	parseAddress(cache, memAddr, &cacheParam1);
+	int line = probeCache(cache, &cacheParam1);
+	if (line >= 0) {
+		cache->hits++;
+		if (exclusive) {
+			invalidateBlock(cache, &cacheParam1, &dirty);
+		} else {
+			touchLine(cache, &cacheParam1, line, write);
+		}
+		return dirty;
+	}
+
+	cache->misses++;
+	dirty = fetchBlock(hier, level + 1, memAddr, 0);
+
+	// An exclusive level lets the block pass straight through to the level above.
+	if (exclusive) {
+		return dirty;
+	}
+	fillLevel(hier, level, memAddr, dirty || write);
+	return 0;
+}
+
+// Send one load or store from the processor into the first level.
+void accessHierarchy(struct hierarchy *hier, unsigned long long memAddr, int write) {
+	fetchBlock(hier, 0, memAddr, write);
+}
+
+void printHierarchy(const struct hierarchy *hier) {
+	printf("%-8s %-9s %4s %6s %4s %12s %12s %12s %12s\n", "level", "inclusion", "s", "E", "b",
+			"hits", "misses", "evictions", "writebacks");
+	for (int level = 0; level < hier->numLevels; level++) {
+		const struct cache *cache = &hier->levels[level];
+		printf("%-8s %-9s %4d %6d %4d %12llu %12llu %12llu %12llu\n", hier->names[level],
+				level == 0 ? "-" : inclusionNames[hier->inclusion[level]],
+				cache->numSetIndexBits, cache->numLines, cache->blockSize,
+				cache->hits, cache->misses, cache->evictions, cache->writebacks);
+	}
+	printf("memory reads:%llu writes:%llu\n", hier->memoryReads, hier->memoryWrites);
+}
@@ -0,0 +1,48 @@
+/*
+ * hierarchy.h - A multi-level cache hierarchy built from the cache model
+ *
+ * The hierarchy is described by a small text file with one level per
+ * line, closest to the processor first:
+ *
+ *     # name  geometry           options
+ *     L1D     s=6  E=8  b=6      policy=lru
+ *     L2      s=10 E=8  b=6      policy=plru  inclusion=nine
+ *     LLC     s=12 E=16 b=6      policy=srrip inclusion=inclusive
+ *
+ * The inclusion of a level describes how it relates to the levels above
+ * it. An inclusive level holds everything the levels above hold and
+ * invalidates their copies when it evicts a block. An exclusive level
+ * only receives the blocks evicted from the level above, and hands a
+ * block back up when it hits. A non-inclusive non-exclusive (nine) level
+ * is filled on every miss that reaches it but never invalidates above.
+ *
+ * All levels are write-back and write-allocate, and must share one block
+ * size. Dirty blocks that are evicted are written back to the level
+ * below, or to memory from the last level.
+ */
+
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include "cache.h"
+
+#define MAX_LEVELS 8
+
+#define INCLUSION_NINE      0
+#define INCLUSION_INCLUSIVE 1
+#define INCLUSION_EXCLUSIVE 2
+
+struct hierarchy {
+	int numLevels;
+	char names[MAX_LEVELS][16];
+	int inclusion[MAX_LEVELS];
+	struct cache levels[MAX_LEVELS];
+	unsigned long long memoryReads;
+	unsigned long long memoryWrites;
+};
+
+void loadHierarchy(struct hierarchy *hier, const char *path, unsigned long long seed);
+void accessHierarchy(struct hierarchy *hier, unsigned long long memAddr, int write);
+void printHierarchy(const struct hierarchy *hier);
+
+#endif /* HIERARCHY_H */
@@ -0,0 +1,180 @@
+/*
+ * libcsim.c - The cache simulator as a library
+ */
+
+#include "libcsim.h"
+#include "cache.h"
+#include <stdlib.h>
+
+// Cache accesses decoded ahead of simulating them in csimBatchAccess.
+#define BATCH_SIZE 256
+
+// Simulated caches whose state takes no more bytes than this stay in the host's caches, where batching gains nothing.
+#define BATCH_MIN_STORAGE (1 << 20)
+
+struct csimSim {
+	struct cache cache;
+	int splitAccesses;
+};
+
+struct csimSim *csimCreate(const struct csimOptions *options) {
+	struct cacheConfig config;
+	const char *policyName = (options->policy != NULL) ? options->policy : "lru";
+
+	if (options->s < 0 || options->s > 30 || options->E < 1 || options->b < 0 || options->s + options->b > 64) {
+		return NULL;
+	}
+	config.numSetIndexBits = options->s;
+	config.numLines = options->E;
+	config.blockSize = options->b;
+	config.policy = findPolicy(policyName);
+	config.seed = options->seed;
+	config.writeThrough = options->writeThrough;
+	config.noWriteAllocate = options->noWriteAllocate;
+	if (config.policy == NULL) {
+		return NULL;
+	}
+
+	struct csimSim *sim = malloc(sizeof(struct csimSim));
+	if (sim == NULL) {
+		return NULL;
+	}
+	if (createCache(&sim->cache, &config) != 0) {
+		free(sim);
+		return NULL;
+	}
+	sim->splitAccesses = options->splitAccesses;
+	return sim;
+}
+
+// The number of bytes of an access of size bytes at addr that are charged to the block holding addr.
+static unsigned int pieceSize(const struct csimSim *sim, unsigned long long addr, unsigned int size) {
+	if (!sim->splitAccesses) {
+		return size;
+	}
+	int b = sim->cache.blockSize;
+	unsigned long long room = (1ULL << b) - (addr & ((1ULL << b) - 1));
+	return (size < room) ? size : room;
+}
+
+// Simulate the access one block at a time, as csim does for a trace record.
+int csimAccess(struct csimSim *sim, char op, unsigned long long addr, unsigned int size) {
+	struct cacheParam param;
+	int result = CSIM_HIT;
+	unsigned int left = size;
+
+	if (op != 'L' && op != 'S' && op != 'M') {
+		return -1;
+	}
+	do {
+		unsigned int piece = pieceSize(sim, addr, left);
+		parseAddress(&sim->cache, addr, &param);
+
+		if (op == 'S') {
+			result |= accessCache(&sim->cache, &param, 1, piece);
+		} else {
+			result |= accessCache(&sim->cache, &param, 0, piece);
+			if (op == 'M') {
+				accessCache(&sim->cache, &param, 1, piece);
+			}
+		}
+		addr += piece;
+		left -= piece;
+	} while (left > 0);
+	return result;
+}
+
+// Decoded cache accesses waiting to be simulated together. Each comes from one piece of an access, and its outcome is
+// added to the outcome of that access unless it is the store of a modify.
+struct pendingBatch {
+	struct cacheParam params[BATCH_SIZE];
+	unsigned char writes[BATCH_SIZE];
+	unsigned int sizes[BATCH_SIZE];
+	long long owners[BATCH_SIZE];   // Index of the access, or -1 if the outcome is not reported.
+	int results[BATCH_SIZE];
+	int count;
+};
+
+static void flushBatch(struct csimSim *sim, struct pendingBatch *batch, int *results) {
+	accessCacheBatch(&sim->cache, batch->params, batch->writes, batch->sizes, batch->count, batch->results);
+	if (results != NULL) {
+		for (int i = 0; i < batch->count; i++) {
+			if (batch->owners[i] >= 0) {
+				results[batch->owners[i]] |= batch->results[i];
+			}
+		}
+	}
+	batch->count = 0;
+}
+
+static void addToBatch(struct csimSim *sim, struct pendingBatch *batch, int *results, unsigned long long addr,
+		int write, unsigned int size, long long owner) {
+	if (batch->count == BATCH_SIZE) {
+		flushBatch(sim, batch, results);
+	}
+	parseAddress(&sim->cache, addr, &batch->params[batch->count]);
+	batch->writes[batch->count] = write;
+	batch->sizes[batch->count] = size;
+	batch->owners[batch->count] = owner;
+	batch->count++;
+}
+
+// Decode up to BATCH_SIZE cache accesses, finding all their sets before any is looked up, then simulate them in order
+// with the sets of later accesses prefetched while earlier ones are resolved. Small caches are simulated one access at
+// a time.
+void csimBatchAccess(struct csimSim *sim, const struct csimAccess *accesses, size_t count, int *results) {
+	struct pendingBatch batch;
+
+	if (sim->cache.setStride * sim->cache.numSets <= BATCH_MIN_STORAGE) {
+		for (size_t i = 0; i < count; i++) {
+			int result = csimAccess(sim, accesses[i].op, accesses[i].addr, accesses[i].size);
+			if (results != NULL) {
+				results[i] = result;
+			}
+		}
+		return;
+	}
+	batch.count = 0;
+	for (size_t i = 0; i < count; i++) {
+		char op = accesses[i].op;
+		unsigned long long addr = accesses[i].addr;
+		unsigned int left = accesses[i].size;
+
+		if (results != NULL) {
+			results[i] = CSIM_HIT;
+		}
+		if (op != 'L' && op != 'S' && op != 'M') {
+			if (results != NULL) {
+				results[i] = -1;
+			}
+			continue;
+		}
+		do {
+			unsigned int piece = pieceSize(sim, addr, left);
+			addToBatch(sim, &batch, results, addr, op == 'S', piece, i);
+			if (op == 'M') {
+				addToBatch(sim, &batch, results, addr, 1, piece, -1);
+			}
+			addr += piece;
+			left -= piece;
+		} while (left > 0);
+	}
+	flushBatch(sim, &batch, results);
+}
+
+void csimGetStats(const struct csimSim *sim, struct csimStats *stats) {
+	stats->hits = sim->cache.hits;
+	stats->misses = sim->cache.misses;
+	stats->evictions = sim->cache.evictions;
+	stats->writebacks = sim->cache.writebacks;
+	stats->fillBytes = sim->cache.fillBytes;
+	stats->writebackBytes = sim->cache.writebackBytes;
+	stats->directWriteBytes = sim->cache.directWriteBytes;
+}
+
+void csimDestroy(struct csimSim *sim) {
+	if (sim != NULL) {
+		freeCache(&sim->cache);
+		free(sim);
+	}
+}
@@ -0,0 +1,81 @@
+/*
+ * libcsim.h - The cache simulator as a library
+ *
+ * libcsim.a and libcsim.so wrap the cache model behind csim in a small C
+ * API, so that other programs can simulate caches in process instead of
+ * running csim and reading .csim_results back. Every simulator is an
+ * independent object: any number of them can be created, fed and read
+ * side by side, and nothing is shared between them. A single simulator
+ * must not be used by two threads at once.
+ *
+ *     struct csimOptions options = {.s = 5, .E = 1, .b = 5};
+ *     struct csimSim *sim = csimCreate(&options);
+ *     csimAccess(sim, 'L', 0x602260, 4);
+ *     csimGetStats(sim, &stats);
+ *     csimDestroy(sim);
+ *
+ * Accesses behave as records of a trace given to csim with the same
+ * options: a modify is a load followed by a store, and the whole access
+ * is charged to the block of its first byte unless splitAccesses is set.
+ */
+
+#ifndef LIBCSIM_H
+#define LIBCSIM_H
+
+#include <stddef.h>
+
+// The functions below are all that libcsim.so exports; the cache model behind them stays hidden.
+#define CSIM_API __attribute__((visibility("default")))
+
+// Outcome bits of an access, the same as those of the cache model.
+#define CSIM_HIT      0
+#define CSIM_MISS     1
+#define CSIM_EVICTION 2
+
+struct csimOptions {
+	int s;                      // Number of set index bits, 0 to 30.
+	int E;                      // Lines per set, at least 1.
+	int b;                      // Number of block offset bits; s + b must not exceed 64.
+	const char *policy;         // Replacement policy as named by csim -p, or NULL for lru.
+	unsigned long long seed;    // Seed of the randomized policies; csim uses 1 unless given -r.
+	int writeThrough;
+	int noWriteAllocate;
+	int splitAccesses;          // Charge an access to every block it touches, like csim -x.
+};
+
+// One data access of a trace.
+struct csimAccess {
+	char op;                    // 'L', 'S' or 'M'
+	unsigned long long addr;
+	unsigned int size;
+};
+
+struct csimStats {
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evictions;
+	unsigned long long writebacks;
+	unsigned long long fillBytes;
+	unsigned long long writebackBytes;
+	unsigned long long directWriteBytes;
+};
+
+struct csimSim;
+
+// Create a simulator with every line invalid. Returns NULL if the options are invalid or the cache could not be
+// allocated.
+CSIM_API struct csimSim *csimCreate(const struct csimOptions *options);
+
+// Simulate one access and return its outcome bits, or -1 if op is not L, S or M. The outcome of a modify is that of
+// its load; the outcomes of the pieces of a split access are combined.
+CSIM_API int csimAccess(struct csimSim *sim, char op, unsigned long long addr, unsigned int size);
+
+// Simulate count accesses in order, storing the outcome of each in results unless it is NULL. The outcomes and counters
+// are exactly those of calling csimAccess on each, but the sets of upcoming accesses are prefetched, which hides much
+// of the host's memory latency when the simulated cache is large.
+CSIM_API void csimBatchAccess(struct csimSim *sim, const struct csimAccess *accesses, size_t count, int *results);
+
+CSIM_API void csimGetStats(const struct csimSim *sim, struct csimStats *stats);
+CSIM_API void csimDestroy(struct csimSim *sim);
+
+#endif /* LIBCSIM_H */
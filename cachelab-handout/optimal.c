@@ -0,0 +1,276 @@
+/*
+ * optimal.c - Belady's optimal replacement (MIN), simulated offline
+ */
+
+#include "optimal.h"
+#include "cache.h"
+#include "traceio.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static void *allocate(size_t count, size_t size) {
+	void *memory = calloc(count ? count : 1, size);
+	if (memory == NULL) {
+		printf("Error could not allocate the optimal cache.\n");
+		exit(EXIT_FAILURE);
+	}
+	return memory;
+}
+
+static unsigned long long hashBlock(unsigned long long block) {
+	block ^= block >> 33;
+	block *= 0xFF51AFD7ED558CCDULL;
+	return block ^ (block >> 33);
+}
+
+// Return the slot of the block, or of the empty slot where it would go.
+static unsigned long long findSlot(const struct blockTable *table, unsigned long long block) {
+	unsigned long long mask = table->size - 1;
+	unsigned long long slot = hashBlock(block) & mask;
+
+	while (table->keys[slot] != 0 && table->keys[slot] != block + 1) {
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+static void createTable(struct blockTable *table) {
+	table->size = 1024;
+	table->used = 0;
+	table->keys = allocate(table->size, sizeof(unsigned long long));
+	table->values = allocate(table->size, sizeof(unsigned long long));
+}
+
+static void freeTable(struct blockTable *table) {
+	free(table->keys);
+	free(table->values);
+	table->keys = table->values = NULL;
+}
+
+// Set the value of a block, doubling the table when it would become more than half full.
+static void putBlock(struct blockTable *table, unsigned long long block, unsigned long long value) {
+	unsigned long long slot = findSlot(table, block);
+
+	if (table->keys[slot] == 0 && 2 * (table->used + 1) > table->size) {
+		struct blockTable old = *table;
+
+		table->size *= 2;
+		table->used = 0;
+		table->keys = allocate(table->size, sizeof(unsigned long long));
+		table->values = allocate(table->size, sizeof(unsigned long long));
+		for (unsigned long long i = 0; i < old.size; i++) {
+			if (old.keys[i] != 0) {
+				putBlock(table, old.keys[i] - 1, old.values[i]);
+			}
+		}
+		freeTable(&old);
+		slot = findSlot(table, block);
+	}
+	if (table->keys[slot] == 0) {
+		table->keys[slot] = block + 1;
+		table->used++;
+	}
+	table->values[slot] = value;
+}
+
+// Take a block out of the table, shifting the entries after it in its probe run back so that no run is broken.
+static void removeBlock(struct blockTable *table, unsigned long long block) {
+	unsigned long long mask = table->size - 1;
+	unsigned long long hole = findSlot(table, block);
+
+	if (table->keys[hole] == 0) {
+		return;
+	}
+	for (unsigned long long slot = (hole + 1) & mask; table->keys[slot] != 0; slot = (slot + 1) & mask) {
+		unsigned long long home = hashBlock(table->keys[slot] - 1) & mask;
+		if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+			table->keys[hole] = table->keys[slot];
+			table->values[hole] = table->values[slot];
+			hole = slot;
+		}
+	}
+	table->keys[hole] = 0;
+	table->used--;
+}
+
+void createOptimal(struct optimalCache *opt, int numSetIndexBits, int numLines, int blockSize, int splitAccesses) {
+	size_t numEntries = ((size_t) 1 << numSetIndexBits) * numLines;
+
+	memset(opt, 0, sizeof(*opt));
+	opt->numSetIndexBits = numSetIndexBits;
+	opt->numLines = numLines;
+	opt->blockSize = blockSize;
+	opt->splitAccesses = splitAccesses;
+	opt->blocks = allocate(numEntries, sizeof(unsigned long long));
+	opt->keys = allocate(numEntries, sizeof(unsigned int));
+	opt->heap = allocate(numEntries, sizeof(int));
+	opt->heapPos = allocate(numEntries, sizeof(int));
+	opt->used = allocate((size_t) 1 << numSetIndexBits, sizeof(int));
+	createTable(&opt->resident);
+}
+
+// Number one access to the block, and make it the next use of the access before it to the same block.
+static void indexAccess(struct optimalCache *opt, struct blockTable *last, unsigned long long block,
+		unsigned long long *capacity) {
+	unsigned long long slot = findSlot(last, block);
+
+	if (opt->numAccesses == OPTIMAL_NEVER) {
+		printf("Error the trace has too many accesses for the optimal policy.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (opt->numAccesses == *capacity) {
+		*capacity *= 2;
+		opt->nextUse = realloc(opt->nextUse, *capacity * sizeof(unsigned int));
+		if (opt->nextUse == NULL) {
+			printf("Error could not allocate the optimal cache.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (last->keys[slot] != 0) {
+		opt->nextUse[last->values[slot]] = opt->numAccesses;
+	}
+	opt->nextUse[opt->numAccesses] = OPTIMAL_NEVER;
+	putBlock(last, block, opt->numAccesses);
+	opt->numAccesses++;
+}
+
+// The first pass: read the whole trace and record the next use of every access. The accesses are numbered exactly as
+// the second pass will make them, one per block touched under -x and two for a modify.
+void indexNextUses(struct optimalCache *opt, const char *trace, int numParsers) {
+	struct traceReader reader;
+	struct traceRecord rec;
+	struct blockTable last;
+	struct stat info;
+	unsigned long long capacity = 1 << 16;
+	unsigned long long blockMask = (1ULL << opt->blockSize) - 1;
+
+	if (strcmp(trace, "-") == 0 || stat(trace, &info) != 0 || !S_ISREG(info.st_mode)) {
+		printf("Error the optimal policy reads the trace twice, so it must be a regular file.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	opt->nextUse = allocate(capacity, sizeof(unsigned int));
+	createTable(&last);
+	openTrace(&reader, trace);
+	if (numParsers > 0) {
+		startTraceParsers(&reader, numParsers);
+	}
+	while (readRecord(&reader, &rec)) {
+		unsigned long long addr = rec.addr;
+		unsigned int left = rec.size;
+
+		if (rec.op != 'L' && rec.op != 'S' && rec.op != 'M') {
+			continue;
+		}
+		do {
+			unsigned int piece = left;
+			if (opt->splitAccesses) {
+				unsigned long long room = blockMask + 1 - (addr & blockMask);
+				piece = (left < room) ? left : room;
+			}
+			indexAccess(opt, &last, addr >> opt->blockSize, &capacity);
+			if (rec.op == 'M') {
+				indexAccess(opt, &last, addr >> opt->blockSize, &capacity);
+			}
+			addr += piece;
+			left -= piece;
+		} while (left > 0);
+	}
+	closeTrace(&reader);
+	freeTable(&last);
+}
+
+static void swapHeap(int *heap, int *heapPos, int a, int b) {
+	int line = heap[a];
+	heap[a] = heap[b];
+	heap[b] = line;
+	heapPos[heap[a]] = a;
+	heapPos[heap[b]] = b;
+}
+
+// Move the entry at position up towards the root while its next use is later than its parent's.
+static void siftUp(const unsigned int *keys, int *heap, int *heapPos, int position) {
+	while (position > 0) {
+		int parent = (position - 1) / 2;
+		if (keys[heap[parent]] >= keys[heap[position]]) {
+			break;
+		}
+		swapHeap(heap, heapPos, parent, position);
+		position = parent;
+	}
+}
+
+static void siftDown(const unsigned int *keys, int *heap, int *heapPos, int used, int position) {
+	for (;;) {
+		int largest = position;
+		int left = 2 * position + 1;
+		int right = left + 1;
+		if (left < used && keys[heap[left]] > keys[heap[largest]]) {
+			largest = left;
+		}
+		if (right < used && keys[heap[right]] > keys[heap[largest]]) {
+			largest = right;
+		}
+		if (largest == position) {
+			return;
+		}
+		swapHeap(heap, heapPos, position, largest);
+		position = largest;
+	}
+}
+
+// Simulate the next access of the second pass. The line of the accessed block always takes the next use of this
+// access, so on a miss the new line's key is set the same way as on a hit.
+int accessOptimal(struct optimalCache *opt, unsigned long long addr) {
+	unsigned long long block = addr >> opt->blockSize;
+	unsigned int set = block & ((1ULL << opt->numSetIndexBits) - 1);
+	size_t base = (size_t) set * opt->numLines;
+	unsigned int *keys = opt->keys + base;
+	int *heap = opt->heap + base;
+	int *heapPos = opt->heapPos + base;
+	unsigned int key = (opt->current < opt->numAccesses) ? opt->nextUse[opt->current] : OPTIMAL_NEVER;
+	unsigned long long slot = findSlot(&opt->resident, block);
+	int result = CACHE_MISS;
+	int line;
+
+	opt->current++;
+	if (opt->resident.keys[slot] != 0) {
+		opt->hits++;
+		line = opt->resident.values[slot];
+		keys[line] = key;
+		siftUp(keys, heap, heapPos, heapPos[line]);
+		return CACHE_HIT;
+	}
+	opt->misses++;
+
+	if (opt->used[set] < opt->numLines) {
+		line = opt->used[set]++;
+		keys[line] = key;
+		heap[line] = line;
+		heapPos[line] = line;
+		siftUp(keys, heap, heapPos, line);
+	} else {
+		// Evict the block used furthest in the future, at the root of the heap.
+		line = heap[0];
+		removeBlock(&opt->resident, opt->blocks[base + line]);
+		opt->evictions++;
+		result |= CACHE_EVICTION;
+		keys[line] = key;
+		siftDown(keys, heap, heapPos, opt->numLines, 0);
+	}
+	opt->blocks[base + line] = block;
+	putBlock(&opt->resident, block, line);
+	return result;
+}
+
+void freeOptimal(struct optimalCache *opt) {
+	free(opt->nextUse);
+	free(opt->blocks);
+	free(opt->keys);
+	free(opt->heap);
+	free(opt->heapPos);
+	free(opt->used);
+	freeTable(&opt->resident);
+}
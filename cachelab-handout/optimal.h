@@ -0,0 +1,66 @@
+/*
+ * optimal.h - Belady's optimal replacement (MIN), simulated offline
+ *
+ * MIN evicts the block whose next use lies furthest in the future, which
+ * gives the fewest misses any replacement policy can achieve with the
+ * same geometry. It needs to see the future, so csim -p opt reads the
+ * trace twice. The first pass numbers every cache access, a modify
+ * counting as a load and a store, and records for each one the number of
+ * the next access to the same block. That index takes 4 bytes per access
+ * and the pass only remembers the last access of every distinct block,
+ * so memory grows linearly with the trace.
+ *
+ * The second pass simulates the cache. Every set keeps its lines in a
+ * binary max-heap ordered by the next use of the block they hold, and a
+ * hash table from block to line finds the resident blocks. A hit raises
+ * the line's next use and a fill replaces the root, so every access takes
+ * O(log E) time. Like the other policies, MIN always allocates a line on
+ * a miss.
+ */
+
+#ifndef OPTIMAL_H
+#define OPTIMAL_H
+
+// The next use of an access whose block is never used again.
+#define OPTIMAL_NEVER 0xFFFFFFFFU
+
+// Open addressing hash table from block to a value, holding block + 1 in its keys and 0 in empty slots.
+struct blockTable {
+	unsigned long long *keys;
+	unsigned long long *values;
+	unsigned long long size;
+	unsigned long long used;
+};
+
+struct optimalCache {
+	int  numSetIndexBits;
+	int  numLines;
+	int  blockSize;
+	int  splitAccesses;
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evictions;
+
+	// The next use of every access, and the number of the access being simulated.
+	unsigned int *nextUse;
+	unsigned long long numAccesses;
+	unsigned long long current;
+
+	// Per set arrays of numLines entries: the block and next use of every line, the heap of lines, and the position
+	// of every line in the heap. The lines in use are always 0 to used - 1, since lines are never invalidated.
+	unsigned long long *blocks;
+	unsigned int *keys;
+	int *heap;
+	int *heapPos;
+	int *used;
+
+	// The line holding every resident block.
+	struct blockTable resident;
+};
+
+void createOptimal(struct optimalCache *opt, int numSetIndexBits, int numLines, int blockSize, int splitAccesses);
+void indexNextUses(struct optimalCache *opt, const char *trace, int numParsers);
+int accessOptimal(struct optimalCache *opt, unsigned long long addr);
+void freeOptimal(struct optimalCache *opt);
+
+#endif /* OPTIMAL_H */
@@ -0,0 +1,149 @@
+/*
+ * parallel.c - Set partitioned parallel simulation of a single cache
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+// Make the queued accesses visible to the worker.
+static void publishHead(struct parallelRing *ring) {
+	__atomic_store_n(&ring->head, ring->pending, __ATOMIC_RELEASE);
+}
+
+// Queue one access, waiting for the worker to make room if its ring is full.
+static void pushItem(struct parallelRing *ring, const struct parallelItem *item) {
+	while (ring->pending - ring->knownTail == RING_SIZE) {
+		publishHead(ring);
+		ring->knownTail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		if (ring->pending - ring->knownTail == RING_SIZE) {
+			sched_yield();
+		}
+	}
+
+	ring->items[ring->pending % RING_SIZE] = *item;
+	ring->pending++;
+	if (ring->pending - ring->head >= RING_BATCH) {
+		publishHead(ring);
+	}
+}
+
+// Simulate every access queued for this worker until the end marker arrives.
+static void *runWorker(void *arg) {
+	struct parallelWorker *worker = arg;
+	struct parallelRing *ring = worker->ring;
+	struct cacheParam cacheParam1;
+	unsigned long long tail = 0;
+
+	for (;;) {
+		unsigned long long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		if (head == tail) {
+			sched_yield();
+			continue;
+		}
+
+		while (tail != head) {
+			const struct parallelItem *item = &ring->items[tail % RING_SIZE];
+			if (item->op == 0) {
+				__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+				return NULL;
+			}
+
+			cacheParam1.tag = item->tag;
+			cacheParam1.s = item->set;
+			if (item->op == 'L' || item->op == 'M') {
+				accessCache(&worker->cache, &cacheParam1, 0, item->size);
+			}
+			if (item->op == 'S' || item->op == 'M') {
+				accessCache(&worker->cache, &cacheParam1, 1, item->size);
+			}
+
+			tail++;
+			if (tail % RING_BATCH == 0) {
+				__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+			}
+		}
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+	}
+}
+
+// Split the sets of the cache among numWorkers threads and start them. There are never more workers than sets.
+void startParallel(struct parallelSim *sim, struct cache *cache, int numWorkers) {
+	if (numWorkers > MAX_WORKERS) {
+		numWorkers = MAX_WORKERS;
+	}
+	if (numWorkers > cache->numSets) {
+		numWorkers = cache->numSets;
+	}
+	sim->cache = cache;
+	sim->numWorkers = numWorkers;
+
+	for (int id = 0; id < numWorkers; id++) {
+		struct parallelWorker *worker = &sim->workers[id];
+		void *ring;
+
+		if (posix_memalign(&ring, 64, sizeof(struct parallelRing)) != 0) {
+			printf("Error could not allocate the worker queues.\n");
+			exit(EXIT_FAILURE);
+		}
+		memset(ring, 0, sizeof(struct parallelRing));
+		worker->ring = ring;
+
+		worker->cache = *cache;
+		worker->cache.hits = 0;
+		worker->cache.misses = 0;
+		worker->cache.evictions = 0;
+		worker->cache.writebacks = 0;
+		worker->cache.fillBytes = 0;
+		worker->cache.writebackBytes = 0;
+		worker->cache.directWriteBytes = 0;
+
+		if (pthread_create(&worker->thread, NULL, runWorker, worker) != 0) {
+			printf("Error could not start a worker thread.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+// Hand one access to the worker that owns its set. Worker id owns the sets from id * numSets / numWorkers on.
+void submitParallel(struct parallelSim *sim, const struct cacheParam *cacheParamPtr, char op, unsigned int size) {
+	struct parallelItem item;
+	int id = ((unsigned long long)cacheParamPtr->s * sim->numWorkers) >> sim->cache->numSetIndexBits;
+
+	item.tag = cacheParamPtr->tag;
+	item.set = cacheParamPtr->s;
+	item.size = size;
+	item.op = op;
+	pushItem(sim->workers[id].ring, &item);
+}
+
+// Tell every worker the trace has ended, wait for them, and add their counters to the cache.
+void finishParallel(struct parallelSim *sim) {
+	struct parallelItem end;
+	struct cache *cache = sim->cache;
+
+	memset(&end, 0, sizeof(end));
+	for (int id = 0; id < sim->numWorkers; id++) {
+		pushItem(sim->workers[id].ring, &end);
+		publishHead(sim->workers[id].ring);
+	}
+
+	for (int id = 0; id < sim->numWorkers; id++) {
+		struct parallelWorker *worker = &sim->workers[id];
+
+		pthread_join(worker->thread, NULL);
+		cache->hits += worker->cache.hits;
+		cache->misses += worker->cache.misses;
+		cache->evictions += worker->cache.evictions;
+		cache->writebacks += worker->cache.writebacks;
+		cache->fillBytes += worker->cache.fillBytes;
+		cache->writebackBytes += worker->cache.writebackBytes;
+		cache->directWriteBytes += worker->cache.directWriteBytes;
+		free(worker->ring);
+		worker->ring = NULL;
+	}
+}
@@ -0,0 +1,62 @@
+/*
+ * parallel.h - Set partitioned parallel simulation of a single cache
+ *
+ * The sets of a cache never interact: every policy keeps its state per
+ * set, and the random ones are seeded per set. So the sets can be split
+ * into contiguous ranges, each owned by one worker thread with its own
+ * counters, while the thread that decodes the trace hands every access
+ * to the worker owning its set. Each worker is fed through its own
+ * single producer, single consumer ring, which needs no locks: the
+ * reader only advances head and the worker only advances tail, and both
+ * publish them in batches to keep the two cores from trading the cache
+ * line on every access. The counters are summed once all workers are
+ * done, so the results are exactly those of the serial simulation.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <pthread.h>
+#include "cache.h"
+
+#define MAX_WORKERS 64
+#define RING_SIZE 4096              // Accesses per ring, a power of two.
+#define RING_BATCH 64               // Accesses between two publications of head or tail.
+
+// One access for a worker. An op of 0 tells the worker that the trace has ended.
+struct parallelItem {
+	unsigned long long tag;
+	unsigned int set;
+	unsigned int size;
+	int op;
+};
+
+struct parallelRing {
+	unsigned long long head __attribute__((aligned(64)));      // Written by the reader.
+	unsigned long long tail __attribute__((aligned(64)));      // Written by the worker.
+
+	// Private to the reader: accesses queued but not yet published, and the last tail it saw.
+	unsigned long long pending __attribute__((aligned(64)));
+	unsigned long long knownTail;
+
+	struct parallelItem items[RING_SIZE] __attribute__((aligned(64)));
+};
+
+// A worker simulates its sets on a copy of the cache that shares the storage of the original but counts on its own.
+struct parallelWorker {
+	pthread_t thread;
+	struct cache cache;
+	struct parallelRing *ring;
+};
+
+struct parallelSim {
+	struct cache *cache;
+	int numWorkers;
+	struct parallelWorker workers[MAX_WORKERS];
+};
+
+void startParallel(struct parallelSim *sim, struct cache *cache, int numWorkers);
+void submitParallel(struct parallelSim *sim, const struct cacheParam *cacheParamPtr, char op, unsigned int size);
+void finishParallel(struct parallelSim *sim);
+
+#endif /* PARALLEL_H */
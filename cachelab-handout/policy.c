@@ -0,0 +1,491 @@
+/*
+ * policy.c - Replacement policies for the cache model
+ */
+
+#include "policy.h"
+#include <stdio.h>
+#include <string.h>
+
+static inline int bitWords(int numLines) {
+	return (numLines + 63) / 64;
+}
+
+// Scramble a seed into a well mixed, non-zero generator state (splitmix64).
+static unsigned long long mixSeed(unsigned long long seed) {
+	seed += 0x9E3779B97F4A7C15ULL;
+	seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+	seed ^= seed >> 31;
+	return seed ? seed : 1;
+}
+
+// Advance an xorshift64* generator.
+static unsigned long long nextRandom(unsigned long long *rng) {
+	*rng ^= *rng >> 12;
+	*rng ^= *rng << 25;
+	*rng ^= *rng >> 27;
+	return *rng * 0x2545F4914F6CDD1DULL;
+}
+
+/*
+ * LRU and FIFO - a doubly linked list of the lines in use, most recent first
+ */
+
+struct listState {
+	int head;
+	int tail;
+	int links[];                // prev of every line, then next of every line
+};
+
+static size_t listStateSize(int numLines) {
+	return sizeof(struct listState) + 2 * numLines * sizeof(int);
+}
+
+static void listInit(void *state, int numLines, unsigned long long seed) {
+	struct listState *list = state;
+	list->head = list->tail = -1;
+	for (int i = 0; i < 2 * numLines; i++) {
+		list->links[i] = -1;
+	}
+}
+
+static void listUnlink(struct listState *list, int numLines, int line) {
+	int *prev = list->links;
+	int *next = list->links + numLines;
+
+	if (prev[line] >= 0) {
+		next[prev[line]] = next[line];
+	} else if (list->head == line) {
+		list->head = next[line];
+	} else {
+		return;                 // Not on the list.
+	}
+	if (next[line] >= 0) {
+		prev[next[line]] = prev[line];
+	} else {
+		list->tail = prev[line];
+	}
+	prev[line] = next[line] = -1;
+}
+
+static void listPushFront(struct listState *list, int numLines, int line) {
+	int *prev = list->links;
+	int *next = list->links + numLines;
+
+	next[line] = list->head;
+	if (list->head >= 0) {
+		prev[list->head] = line;
+	} else {
+		list->tail = line;
+	}
+	list->head = line;
+}
+
+static void listMoveToFront(void *state, int numLines, int line) {
+	struct listState *list = state;
+	if (list->head != line) {
+		listUnlink(list, numLines, line);
+		listPushFront(list, numLines, line);
+	}
+}
+
+static void listNoTouch(void *state, int numLines, int line) {
+}
+
+static int listVictim(void *state, int numLines) {
+	return ((struct listState *)state)->tail;
+}
+
+static void listInvalidate(void *state, int numLines, int line) {
+	listUnlink(state, numLines, line);
+}
+
+/*
+ * Random - a per set xorshift generator, so results do not depend on how sets interleave
+ */
+
+static size_t randomStateSize(int numLines) {
+	return sizeof(unsigned long long);
+}
+
+static void randomInit(void *state, int numLines, unsigned long long seed) {
+	*(unsigned long long *)state = mixSeed(seed);
+}
+
+static void randomNoUpdate(void *state, int numLines, int line) {
+}
+
+static int randomVictim(void *state, int numLines) {
+	return nextRandom(state) % numLines;
+}
+
+/*
+ * Tree PLRU - one bit per node of a binary tree over the lines, pointing towards the next victim. With a number of
+ * lines that is not a power of two the tree is padded, and walks never step into a subtree with no real lines.
+ */
+
+static int treeLeaves(int numLines) {
+	int leaves = 1;
+	while (leaves < numLines) {
+		leaves *= 2;
+	}
+	return leaves;
+}
+
+static size_t treeStateSize(int numLines) {
+	return treeLeaves(numLines);
+}
+
+static void treeInit(void *state, int numLines, unsigned long long seed) {
+}
+
+// Point every node on the path to the line away from it. A set bit sends the next victim search right.
+static void treeTouch(void *state, int numLines, int line) {
+	unsigned char *bits = state;
+	int node = 0;
+	int low = 0;
+	int high = treeLeaves(numLines);
+
+	while (high - low > 1) {
+		int mid = (low + high) / 2;
+		if (line < mid) {
+			bits[node] = 1;
+			node = 2 * node + 1;
+			high = mid;
+		} else {
+			bits[node] = 0;
+			node = 2 * node + 2;
+			low = mid;
+		}
+	}
+}
+
+// Invalid lines are refilled before any victim is chosen, so the tree needs no update.
+static void treeInvalidate(void *state, int numLines, int line) {
+}
+
+static int treeVictim(void *state, int numLines) {
+	unsigned char *bits = state;
+	int node = 0;
+	int low = 0;
+	int high = treeLeaves(numLines);
+
+	while (high - low > 1) {
+		int mid = (low + high) / 2;
+		if (bits[node] && mid < numLines) {
+			node = 2 * node + 2;
+			low = mid;
+		} else {
+			node = 2 * node + 1;
+			high = mid;
+		}
+	}
+	return low;
+}
+
+/*
+ * Bit PLRU - one MRU bit per line. When the last bit would be set, all others are cleared.
+ */
+
+struct mruState {
+	int marked;
+	unsigned long long bits[];
+};
+
+static size_t mruStateSize(int numLines) {
+	return sizeof(struct mruState) + bitWords(numLines) * sizeof(unsigned long long);
+}
+
+static void mruInit(void *state, int numLines, unsigned long long seed) {
+}
+
+static void mruTouch(void *state, int numLines, int line) {
+	struct mruState *mru = state;
+	unsigned long long bit = 1ULL << (line % 64);
+
+	if (mru->bits[line / 64] & bit) {
+		return;
+	}
+	if (++mru->marked == numLines) {
+		memset(mru->bits, 0, bitWords(numLines) * sizeof(unsigned long long));
+		mru->marked = 1;
+	}
+	mru->bits[line / 64] |= bit;
+}
+
+// Unmark the line, so that it no longer counts towards the marks that clear the set.
+static void mruInvalidate(void *state, int numLines, int line) {
+	struct mruState *mru = state;
+	unsigned long long bit = 1ULL << (line % 64);
+
+	if (mru->bits[line / 64] & bit) {
+		mru->bits[line / 64] &= ~bit;
+		mru->marked--;
+	}
+}
+
+// The first unmarked line. Only a single line set can have every line marked.
+static int mruVictim(void *state, int numLines) {
+	struct mruState *mru = state;
+	int words = bitWords(numLines);
+
+	for (int word = 0; word < words; word++) {
+		unsigned long long unmarked = ~mru->bits[word];
+		if (word == words - 1 && numLines % 64 != 0) {
+			unmarked &= (1ULL << (numLines % 64)) - 1;
+		}
+		if (unmarked != 0) {
+			return word * 64 + __builtin_ctzll(unmarked);
+		}
+	}
+	return 0;
+}
+
+/*
+ * SRRIP and BRRIP - a 2 bit re-reference prediction value per line, kept as one bitmap per value so that finding a
+ * distant line and aging the whole set both take one pass over the bitmap words.
+ */
+
+#define RRPV_MAX 3
+
+struct rripState {
+	unsigned long long rng;
+	unsigned long long levels[];  // RRPV_MAX + 1 bitmaps of bitWords(numLines) words each
+};
+
+static size_t rripStateSize(int numLines) {
+	return sizeof(struct rripState) + (RRPV_MAX + 1) * bitWords(numLines) * sizeof(unsigned long long);
+}
+
+static void rripInit(void *state, int numLines, unsigned long long seed) {
+	((struct rripState *)state)->rng = mixSeed(seed);
+}
+
+static void rripSet(struct rripState *rrip, int numLines, int line, int value) {
+	int words = bitWords(numLines);
+	unsigned long long bit = 1ULL << (line % 64);
+
+	for (int level = 0; level <= RRPV_MAX; level++) {
+		rrip->levels[level * words + line / 64] &= ~bit;
+	}
+	rrip->levels[value * words + line / 64] |= bit;
+}
+
+static void rripTouch(void *state, int numLines, int line) {
+	rripSet(state, numLines, line, 0);
+}
+
+static void rripInvalidate(void *state, int numLines, int line) {
+	struct rripState *rrip = state;
+	int words = bitWords(numLines);
+
+	for (int level = 0; level <= RRPV_MAX; level++) {
+		rrip->levels[level * words + line / 64] &= ~(1ULL << (line % 64));
+	}
+}
+
+// Static RRIP inserts with a long re-reference interval.
+static void srripFill(void *state, int numLines, int line) {
+	rripSet(state, numLines, line, RRPV_MAX - 1);
+}
+
+// Bimodal RRIP inserts with a distant interval, except for one fill in 32.
+static void brripFill(void *state, int numLines, int line) {
+	struct rripState *rrip = state;
+	rripSet(rrip, numLines, line, nextRandom(&rrip->rng) % 32 == 0 ? RRPV_MAX - 1 : RRPV_MAX);
+}
+
+static int rripVictim(void *state, int numLines) {
+	struct rripState *rrip = state;
+	int words = bitWords(numLines);
+	int highest = RRPV_MAX;
+
+	// Find the most distant value in use. Aging every line until one reaches RRPV_MAX is then a shift of the bitmaps.
+	for (;;) {
+		int word = 0;
+		while (word < words && rrip->levels[highest * words + word] == 0) {
+			word++;
+		}
+		if (word < words) {
+			break;
+		}
+		highest--;
+	}
+
+	int shift = RRPV_MAX - highest;
+	if (shift > 0) {
+		memmove(&rrip->levels[shift * words], rrip->levels, (RRPV_MAX + 1 - shift) * words * sizeof(unsigned long long));
+		memset(rrip->levels, 0, shift * words * sizeof(unsigned long long));
+	}
+
+	for (int word = 0; ; word++) {
+		unsigned long long distant = rrip->levels[RRPV_MAX * words + word];
+		if (distant != 0) {
+			return word * 64 + __builtin_ctzll(distant);
+		}
+	}
+}
+
+/*
+ * LFU - a binary min heap of lines ordered by use count, with the least recently used line first among equals
+ */
+
+struct lfuState {
+	unsigned long long clock;
+	int size;
+	int padding;
+	unsigned long long data[];  // stamp of every line, then heap, position and count of every line as ints
+};
+
+struct lfuView {
+	unsigned long long *stamp;
+	int *heap;
+	int *pos;
+	unsigned int *count;
+};
+
+static size_t lfuStateSize(int numLines) {
+	return sizeof(struct lfuState) + numLines * (sizeof(unsigned long long) + 3 * sizeof(int));
+}
+
+static struct lfuView lfuView(struct lfuState *lfu, int numLines) {
+	struct lfuView view;
+	view.stamp = lfu->data;
+	view.heap = (int *)(lfu->data + numLines);
+	view.pos = view.heap + numLines;
+	view.count = (unsigned int *)(view.pos + numLines);
+	return view;
+}
+
+static void lfuInit(void *state, int numLines, unsigned long long seed) {
+	struct lfuView view = lfuView(state, numLines);
+	for (int line = 0; line < numLines; line++) {
+		view.pos[line] = -1;
+	}
+}
+
+static int lfuLess(const struct lfuView *view, int a, int b) {
+	if (view->count[a] != view->count[b]) {
+		return view->count[a] < view->count[b];
+	}
+	return view->stamp[a] < view->stamp[b];
+}
+
+static void lfuSwap(const struct lfuView *view, int i, int j) {
+	int line = view->heap[i];
+	view->heap[i] = view->heap[j];
+	view->heap[j] = line;
+	view->pos[view->heap[i]] = i;
+	view->pos[view->heap[j]] = j;
+}
+
+static void lfuSiftUp(const struct lfuView *view, int i) {
+	while (i > 0 && lfuLess(view, view->heap[i], view->heap[(i - 1) / 2])) {
+		lfuSwap(view, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void lfuSiftDown(const struct lfuView *view, int size, int i) {
+	for (;;) {
+		int smallest = i;
+		int left = 2 * i + 1;
+		int right = left + 1;
+
+		if (left < size && lfuLess(view, view->heap[left], view->heap[smallest])) {
+			smallest = left;
+		}
+		if (right < size && lfuLess(view, view->heap[right], view->heap[smallest])) {
+			smallest = right;
+		}
+		if (smallest == i) {
+			return;
+		}
+		lfuSwap(view, i, smallest);
+		i = smallest;
+	}
+}
+
+static void lfuTouch(void *state, int numLines, int line) {
+	struct lfuState *lfu = state;
+	struct lfuView view = lfuView(lfu, numLines);
+
+	view.count[line]++;
+	view.stamp[line] = lfu->clock++;
+	lfuSiftDown(&view, lfu->size, view.pos[line]);
+}
+
+static void lfuFill(void *state, int numLines, int line) {
+	struct lfuState *lfu = state;
+	struct lfuView view = lfuView(lfu, numLines);
+
+	view.count[line] = 1;
+	view.stamp[line] = lfu->clock++;
+	if (view.pos[line] < 0) {
+		view.heap[lfu->size] = line;
+		view.pos[line] = lfu->size++;
+		lfuSiftUp(&view, view.pos[line]);
+	} else {
+		lfuSiftDown(&view, lfu->size, view.pos[line]);
+		lfuSiftUp(&view, view.pos[line]);
+	}
+}
+
+static int lfuVictim(void *state, int numLines) {
+	struct lfuView view = lfuView(state, numLines);
+	return view.heap[0];
+}
+
+// Move the last heap entry into the line's place and restore the heap order around it.
+static void lfuInvalidate(void *state, int numLines, int line) {
+	struct lfuState *lfu = state;
+	struct lfuView view = lfuView(lfu, numLines);
+	int i = view.pos[line];
+
+	if (i < 0) {
+		return;
+	}
+	lfu->size--;
+	if (i != lfu->size) {
+		lfuSwap(&view, i, lfu->size);
+		lfuSiftDown(&view, lfu->size, i);
+		lfuSiftUp(&view, i);
+	}
+	view.pos[line] = -1;
+}
+
+static const struct policy policies[] = {
+	{ "lru",     "true least recently used",
+	  listStateSize, listInit, listMoveToFront, listMoveToFront, listVictim, listInvalidate },
+	{ "fifo",    "first in, first out",
+	  listStateSize, listInit, listNoTouch, listMoveToFront, listVictim, listInvalidate },
+	{ "random",  "uniformly random victim, seeded with -r",
+	  randomStateSize, randomInit, randomNoUpdate, randomNoUpdate, randomVictim, randomNoUpdate },
+	{ "plru",    "tree pseudo-LRU",
+	  treeStateSize, treeInit, treeTouch, treeTouch, treeVictim, treeInvalidate },
+	{ "bitplru", "bit pseudo-LRU (MRU bits)",
+	  mruStateSize, mruInit, mruTouch, mruTouch, mruVictim, mruInvalidate },
+	{ "srrip",   "static re-reference interval prediction",
+	  rripStateSize, rripInit, rripTouch, srripFill, rripVictim, rripInvalidate },
+	{ "brrip",   "bimodal re-reference interval prediction, seeded with -r",
+	  rripStateSize, rripInit, rripTouch, brripFill, rripVictim, rripInvalidate },
+	{ "lfu",     "least frequently used, ties broken by LRU",
+	  lfuStateSize, lfuInit, lfuTouch, lfuFill, lfuVictim, lfuInvalidate },
+};
+
+#define NUM_POLICIES ((int)(sizeof(policies) / sizeof(policies[0])))
+
+const struct policy *findPolicy(const char *name) {
+	for (int i = 0; i < NUM_POLICIES; i++) {
+		if (strcmp(policies[i].name, name) == 0) {
+			return &policies[i];
+		}
+	}
+	return NULL;
+}
+
+void listPolicies() {
+	for (int i = 0; i < NUM_POLICIES; i++) {
+		printf("  %-8s %s\n", policies[i].name, policies[i].description);
+	}
+}
@@ -0,0 +1,47 @@
+/*
+ * policy.h - Replacement policies for the cache model
+ *
+ * A policy keeps its own state for every set, in a block of memory the
+ * cache reserves next to the set's tags. The cache tells the policy
+ * about every hit and fill, and asks it for a victim only when the set
+ * is full, and about lines that are invalidated behind its back when
+ * another level of a hierarchy takes their block away. Victim selection
+ * is O(1) or O(log E) for every policy except bit-PLRU and the RRIP
+ * family, which scan one bitmap word per 64 ways.
+ */
+
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <stddef.h>
+
+struct policy {
+	const char *name;
+	const char *description;
+
+	// Bytes of state needed per set.
+	size_t (*stateSize)(int numLines);
+
+	// Prepare the zeroed state of one set. The seed is already mixed with the set index.
+	void (*init)(void *state, int numLines, unsigned long long seed);
+
+	// The line was hit.
+	void (*touch)(void *state, int numLines, int line);
+
+	// A block was brought into the line, which was either unused or just chosen as the victim.
+	void (*fill)(void *state, int numLines, int line);
+
+	// Pick the line to evict from a full set.
+	int (*victim)(void *state, int numLines);
+
+	// The line was invalidated and is free until its next fill.
+	void (*invalidate)(void *state, int numLines, int line);
+};
+
+// Look a policy up by name, returning NULL if there is no such policy.
+const struct policy *findPolicy(const char *name);
+
+// Print the name and description of every policy.
+void listPolicies();
+
+#endif /* POLICY_H */
@@ -6,3 +6,5 @@
  ./csim-ref -s 2 -E 4 -b 3 -t traces/trans.trace
  ./csim-ref -s 5 -E 1 -b 5 -t traces/trans.trace
  ./csim-ref -s 5 -E 1 -b 5 -t traces/long.trace
+ ./csim-ref -s 2 -E 2 -b 4 -t traces/wide.trace
+ ./csim-ref -s 4 -E 1 -b 5 -t traces/wide.trace
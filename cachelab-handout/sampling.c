@@ -0,0 +1,197 @@
+/*
+ * sampling.c - Estimating cache statistics from a sample of the trace
+ */
+
+#include "sampling.h"
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Parse "sets=<ratio>" or "time=<period>,<warmup>,<window>". Returns 0 on success and -1 if the spec is malformed.
+int parseSampling(struct sampler *sampler, const char *spec) {
+	unsigned long long period, warmup, window;
+	int ratio;
+	char extra;
+
+	memset(sampler, 0, sizeof(*sampler));
+	if (sscanf(spec, "sets=%d%c", &ratio, &extra) == 1) {
+		if (ratio < 1) {
+			return -1;
+		}
+		sampler->mode = SAMPLE_SETS;
+		sampler->ratio = ratio;
+		return 0;
+	}
+	if (sscanf(spec, "time=%llu,%llu,%llu%c", &period, &warmup, &window, &extra) == 3) {
+		if (window < 1 || warmup + window > period) {
+			return -1;
+		}
+		sampler->mode = SAMPLE_TIME;
+		sampler->period = period;
+		sampler->warmup = warmup;
+		sampler->window = window;
+		return 0;
+	}
+	return -1;
+}
+
+// Spread the set indices before bucketing them, so that sampling does not line up with strided access patterns.
+static unsigned int hashSet(unsigned int set) {
+	unsigned long long hash = set + 0x9E3779B97F4A7C15ULL;
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+	return (hash ^ (hash >> 31)) >> 32;
+}
+
+// Choose the sampled sets of a cache with 2^numSetIndexBits sets.
+void startSampling(struct sampler *sampler, int numSetIndexBits) {
+	if (sampler->mode != SAMPLE_SETS) {
+		return;
+	}
+
+	sampler->numSets = 1 << numSetIndexBits;
+	sampler->chosen = calloc(sampler->numSets, 1);
+	sampler->setAccesses = calloc(sampler->numSets, sizeof(unsigned long long));
+	sampler->setMisses = calloc(sampler->numSets, sizeof(unsigned long long));
+	if (sampler->chosen == NULL || sampler->setAccesses == NULL || sampler->setMisses == NULL) {
+		printf("Error could not allocate the sampler.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int set = 0; set < sampler->numSets; set++) {
+		if (hashSet(set) % sampler->ratio == 0) {
+			sampler->chosen[set] = 1;
+			sampler->numChosen++;
+		}
+	}
+	if (sampler->numChosen < 2) {
+		printf("Set sampling needs at least two sampled sets, use a smaller ratio\n");
+		exit(1);
+	}
+}
+
+// Add one observation of accesses and misses to the sums.
+static void observe(struct sampler *sampler, unsigned long long accesses, unsigned long long misses) {
+	sampler->observations++;
+	sampler->sumAccesses += accesses;
+	sampler->sumMisses += misses;
+	sampler->sumAccessesSq += (double)accesses * accesses;
+	sampler->sumMissesSq += (double)misses * misses;
+	sampler->sumProduct += (double)accesses * misses;
+}
+
+// Tell whether the next record is skipped, only warms the cache, or is measured, and move on to the record after it.
+// Set sampling measures every record.
+int samplePhase(struct sampler *sampler) {
+	if (sampler->mode != SAMPLE_TIME) {
+		return SAMPLE_MEASURE;
+	}
+
+	unsigned long long position = sampler->position;
+	unsigned long long measureStart = sampler->period - sampler->window;
+
+	sampler->position = (position + 1) % sampler->period;
+	if (position == measureStart) {
+		if (sampler->windowOpen) {
+			observe(sampler, sampler->windowAccesses, sampler->windowMisses);
+		}
+		sampler->windowOpen = 1;
+		sampler->windowAccesses = 0;
+		sampler->windowMisses = 0;
+	}
+	if (position >= measureStart) {
+		return SAMPLE_MEASURE;
+	}
+	return (position >= measureStart - sampler->warmup) ? SAMPLE_WARM : SAMPLE_SKIP;
+}
+
+// Tell whether accesses to the set are simulated.
+int sampleSet(const struct sampler *sampler, unsigned int set) {
+	return sampler->mode != SAMPLE_SETS || sampler->chosen[set];
+}
+
+// Count the outcome of a measured access to the set.
+void recordSample(struct sampler *sampler, unsigned int set, int result) {
+	int miss = (result & CACHE_MISS) != 0;
+
+	sampler->measuredAccesses++;
+	sampler->measuredMisses += miss;
+	sampler->measuredEvictions += (result & CACHE_EVICTION) != 0;
+	if (sampler->mode == SAMPLE_SETS) {
+		sampler->setAccesses[set]++;
+		sampler->setMisses[set] += miss;
+	} else {
+		sampler->windowAccesses++;
+		sampler->windowMisses += miss;
+	}
+}
+
+// Turn the counters of the sampled sets, or of the last window, into observations once the trace is done.
+void finishSampling(struct sampler *sampler) {
+	if (sampler->mode == SAMPLE_TIME) {
+		if (sampler->windowOpen && sampler->windowAccesses > 0) {
+			observe(sampler, sampler->windowAccesses, sampler->windowMisses);
+		}
+		return;
+	}
+	for (int set = 0; set < sampler->numSets; set++) {
+		if (sampler->chosen[set]) {
+			observe(sampler, sampler->setAccesses[set], sampler->setMisses[set]);
+		}
+	}
+}
+
+// Print the estimated misses with their 95% confidence interval, and scale the estimates to the whole trace.
+//
+// Under set sampling the misses of the sampled sets are scaled up by the sampling ratio, with the variance taken from
+// the spread of the per set misses and a finite population correction. Accesses are far from evenly spread over the
+// sets of most traces, so this stays unbiased where scaling the sampled miss ratio by all accesses would not. Under
+// time sampling the miss ratio of the windows is scaled by all accesses instead, with the variance of that ratio
+// estimator taken from the linearized residuals m - r * a of the windows (Cochran, Sampling Techniques, 6.4).
+void printSampling(const struct sampler *sampler, unsigned long long *hits, unsigned long long *misses,
+		unsigned long long *evictions) {
+	double n = sampler->observations;
+	double total = sampler->totalAccesses;
+	double estimate = 0.0;
+	double halfWidth = 0.0;
+	double scale;
+
+	if (sampler->mode == SAMPLE_SETS) {
+		printf("set sampling: %d of %d sets\n", sampler->numChosen, sampler->numSets);
+		scale = (double)sampler->numSets / sampler->numChosen;
+		estimate = sampler->measuredMisses * scale;
+		if (n >= 2) {
+			double variance = (sampler->sumMissesSq - sampler->sumMisses * sampler->sumMisses / n) / (n - 1);
+			variance *= 1.0 - n / sampler->numSets;
+			halfWidth = 1.96 * sampler->numSets * sqrt(variance > 0 ? variance / n : 0);
+		}
+	} else {
+		printf("time sampling: %llu of every %llu records after %llu of warm-up, %llu windows\n", sampler->window,
+				sampler->period, sampler->warmup, sampler->observations);
+		scale = sampler->measuredAccesses ? total / sampler->measuredAccesses : 0.0;
+		estimate = sampler->measuredMisses * scale;
+		if (n >= 2 && sampler->sumAccesses > 0) {
+			double ratio = sampler->sumMisses / sampler->sumAccesses;
+			double residualSq = sampler->sumMissesSq - 2 * ratio * sampler->sumProduct
+					+ ratio * ratio * sampler->sumAccessesSq;
+			double variance = residualSq / (n - 1) / n;
+			halfWidth = 1.96 * sqrt(variance > 0 ? variance : 0) / (sampler->sumAccesses / n) * total;
+		}
+	}
+
+	if (estimate > total) {
+		estimate = total;
+	}
+	*misses = llround(estimate);
+	*hits = sampler->totalAccesses - *misses;
+	*evictions = llround(sampler->measuredEvictions * scale);
+	if (*evictions > *misses) {
+		*evictions = *misses;
+	}
+
+	printf("measured accesses:%llu of %llu\n", sampler->measuredAccesses, sampler->totalAccesses);
+	printf("estimated misses:%llu +- %.0f (95%% confidence)\n", *misses, halfWidth);
+	printf("miss ratio:%.6f +- %.6f\n", total ? estimate / total : 0.0, total ? halfWidth / total : 0.0);
+}
@@ -0,0 +1,74 @@
+/*
+ * sampling.h - Estimating cache statistics from a sample of the trace
+ *
+ * Set sampling only simulates the sets whose hashed index falls into one
+ * of ratio buckets, and treats every sampled set as one observation.
+ * Time sampling follows SMARTS (Wunderlich et al., 2003): the trace is
+ * cut into periods of fixed length, and in every period the accesses of
+ * a short window are measured after a stretch of warm-up accesses that
+ * only update the cache. The rest of the period is skipped, so a warm-up
+ * of period - window records gives continuous functional warming.
+ *
+ * Set sampling scales the misses of the sampled sets by the sampling
+ * ratio; time sampling scales the miss ratio of the windows by all the
+ * accesses of the trace, which are always counted. Either way the 95%
+ * confidence interval comes from the spread of the observations, the
+ * sampled sets or the measured windows.
+ */
+
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#define SAMPLE_NONE 0
+#define SAMPLE_SETS 1
+#define SAMPLE_TIME 2
+
+// What to do with the next record under time sampling.
+#define SAMPLE_SKIP 0
+#define SAMPLE_WARM 1
+#define SAMPLE_MEASURE 2
+
+struct sampler {
+	int mode;
+
+	// Set sampling: one in ratio sets is simulated, and each has its own counters.
+	int ratio;
+	int numSets;
+	int numChosen;
+	unsigned char *chosen;
+	unsigned long long *setAccesses;
+	unsigned long long *setMisses;
+
+	// Time sampling: the position of the current record within its period, and the counters of the current window.
+	unsigned long long period;
+	unsigned long long warmup;
+	unsigned long long window;
+	unsigned long long position;
+	int windowOpen;
+	unsigned long long windowAccesses;
+	unsigned long long windowMisses;
+
+	// Sums over the observations, from which the miss ratio and its variance are estimated.
+	unsigned long long observations;
+	double sumAccesses;
+	double sumMisses;
+	double sumAccessesSq;
+	double sumMissesSq;
+	double sumProduct;
+
+	unsigned long long measuredAccesses;
+	unsigned long long measuredMisses;
+	unsigned long long measuredEvictions;
+	unsigned long long totalAccesses;
+};
+
+int parseSampling(struct sampler *sampler, const char *spec);
+void startSampling(struct sampler *sampler, int numSetIndexBits);
+int samplePhase(struct sampler *sampler);
+int sampleSet(const struct sampler *sampler, unsigned int set);
+void recordSample(struct sampler *sampler, unsigned int set, int result);
+void finishSampling(struct sampler *sampler);
+void printSampling(const struct sampler *sampler, unsigned long long *hits, unsigned long long *misses,
+		unsigned long long *evictions);
+
+#endif /* SAMPLING_H */
@@ -0,0 +1,106 @@
+/*
+ * setscan.c - Scalar and vectorized scans over the lines of one cache set
+ */
+
+#include "setscan.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+static inline int isValid(const unsigned long long *valid, int line) {
+	return valid[line / 64] >> (line % 64) & 1;
+}
+
+static int findTagScalar(const unsigned long long *tags, const unsigned long long *valid, int numLines,
+		unsigned long long tag) {
+	for (int line = 0; line < numLines; line++) {
+		if (tags[line] == tag && isValid(valid, line)) {
+			return line;
+		}
+	}
+	return -1;
+}
+
+#ifdef HAVE_X86_SIMD
+
+// Compare four tags at a time. The lanes that match are masked with the matching nibble of the valid bitmap, which is
+// always aligned since line is a multiple of four.
+__attribute__((target("avx2")))
+static int findTagAVX2(const unsigned long long *tags, const unsigned long long *valid, int numLines,
+		unsigned long long tag) {
+	__m256i needle = _mm256_set1_epi64x(tag);
+	int line = 0;
+
+	for (; line + 4 <= numLines; line += 4) {
+		__m256i block = _mm256_loadu_si256((const __m256i *)&tags[line]);
+		unsigned int match = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(block, needle)));
+		match &= valid[line / 64] >> (line % 64);
+		if (match & 0xf) {
+			return line + __builtin_ctz(match);
+		}
+	}
+	for (; line < numLines; line++) {
+		if (tags[line] == tag && isValid(valid, line)) {
+			return line;
+		}
+	}
+	return -1;
+}
+
+__attribute__((target("sse4.1")))
+static int findTagSSE4(const unsigned long long *tags, const unsigned long long *valid, int numLines,
+		unsigned long long tag) {
+	__m128i needle = _mm_set1_epi64x(tag);
+	int line = 0;
+
+	for (; line + 2 <= numLines; line += 2) {
+		__m128i block = _mm_loadu_si128((const __m128i *)&tags[line]);
+		unsigned int match = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(block, needle)));
+		match &= valid[line / 64] >> (line % 64);
+		if (match & 0x3) {
+			return line + __builtin_ctz(match);
+		}
+	}
+	for (; line < numLines; line++) {
+		if (tags[line] == tag && isValid(valid, line)) {
+			return line;
+		}
+	}
+	return -1;
+}
+
+#endif
+
+static const struct setScan scalarScan = { "scalar", findTagScalar };
+#ifdef HAVE_X86_SIMD
+static const struct setScan sse4Scan = { "sse4", findTagSSE4 };
+static const struct setScan avx2Scan = { "avx2", findTagAVX2 };
+#endif
+
+const struct setScan *chooseSetScan() {
+	const char *forced = getenv("CSIM_SIMD");
+
+	if (forced != NULL && strcmp(forced, "scalar") == 0) {
+		return &scalarScan;
+	}
+#ifdef HAVE_X86_SIMD
+	__builtin_cpu_init();
+	int hasAVX2 = __builtin_cpu_supports("avx2");
+	int hasSSE4 = __builtin_cpu_supports("sse4.1");
+
+	if (forced != NULL && strcmp(forced, "sse4") == 0) {
+		return hasSSE4 ? &sse4Scan : &scalarScan;
+	}
+	if (hasAVX2) {
+		return &avx2Scan;
+	}
+	if (hasSSE4) {
+		return &sse4Scan;
+	}
+#endif
+	return &scalarScan;
+}
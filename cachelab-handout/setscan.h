@@ -0,0 +1,25 @@
+/*
+ * setscan.h - Scans over the lines of one cache set
+ *
+ * The scan that dominates highly associative configurations, finding a
+ * valid line with a given tag, has scalar, SSE4.1 and AVX2 versions. The
+ * widest one the host supports is picked at run time, and all of them
+ * give identical answers.
+ */
+
+#ifndef SETSCAN_H
+#define SETSCAN_H
+
+// Return the index of the valid line holding tag, or -1 if there is none.
+typedef int (*findTagFn)(const unsigned long long *tags, const unsigned long long *valid, int numLines,
+		unsigned long long tag);
+
+struct setScan {
+	const char *name;
+	findTagFn findTag;
+};
+
+// Pick the scans for this host. Setting CSIM_SIMD to scalar, sse4 or avx2 overrides the choice.
+const struct setScan *chooseSetScan();
+
+#endif /* SETSCAN_H */
@@ -0,0 +1,107 @@
+/*
+ * snapshot.c - Saving and restoring the state of a simulated cache
+ */
+
+#include "snapshot.h"
+#include "policy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Write the cache and the trace position to path. The snapshot is written to a temporary file first and renamed over
+// path, so an interrupted save never destroys the previous snapshot.
+void saveSnapshot(const char *path, const struct cache *cache, int splitAccesses,
+		const struct tracePosition *position) {
+	struct snapshotHeader header;
+	char temporary[4096];
+
+	memset(&header, 0, sizeof(header));
+	header.numSetIndexBits = cache->numSetIndexBits;
+	header.numLines = cache->numLines;
+	header.blockSize = cache->blockSize;
+	snprintf(header.policy, sizeof(header.policy), "%s", cache->policy->name);
+	header.writeThrough = cache->writeThrough;
+	header.noWriteAllocate = cache->noWriteAllocate;
+	header.splitAccesses = splitAccesses;
+	header.hits = cache->hits;
+	header.misses = cache->misses;
+	header.evictions = cache->evictions;
+	header.writebacks = cache->writebacks;
+	header.fillBytes = cache->fillBytes;
+	header.writebackBytes = cache->writebackBytes;
+	header.directWriteBytes = cache->directWriteBytes;
+	header.position = *position;
+	header.storageSize = cache->setStride * cache->numSets;
+
+	snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+	FILE *file = fopen(temporary, "wb");
+	if (file == NULL) {
+		printf("Error could not create snapshot %s.\n", path);
+		exit(EXIT_FAILURE);
+	}
+	if (fwrite(SNAPSHOT_MAGIC, 1, SNAPSHOT_MAGIC_LENGTH, file) != SNAPSHOT_MAGIC_LENGTH
+			|| fwrite(&header, sizeof(header), 1, file) != 1
+			|| fwrite(cache->storage, 1, header.storageSize, file) != header.storageSize
+			|| fclose(file) != 0) {
+		printf("Error could not write snapshot %s.\n", path);
+		exit(EXIT_FAILURE);
+	}
+	if (rename(temporary, path) != 0) {
+		printf("Error could not write snapshot %s.\n", path);
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Create the cache described by the snapshot at path, with the state it was saved in, and return where in the trace
+// the simulation stopped.
+void loadSnapshot(const char *path, struct cache *cache, int *splitAccesses, struct tracePosition *position) {
+	struct snapshotHeader header;
+	struct cacheConfig config;
+	char magic[SNAPSHOT_MAGIC_LENGTH];
+
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		printf("Error could not open snapshot %s.\n", path);
+		exit(EXIT_FAILURE);
+	}
+	if (fread(magic, 1, SNAPSHOT_MAGIC_LENGTH, file) != SNAPSHOT_MAGIC_LENGTH
+			|| memcmp(magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LENGTH) != 0
+			|| fread(&header, sizeof(header), 1, file) != 1) {
+		printf("Error %s is not a snapshot.\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	header.policy[sizeof(header.policy) - 1] = '\0';
+	config.numSetIndexBits = header.numSetIndexBits;
+	config.numLines = header.numLines;
+	config.blockSize = header.blockSize;
+	config.policy = findPolicy(header.policy);
+	config.seed = 0;
+	config.writeThrough = header.writeThrough;
+	config.noWriteAllocate = header.noWriteAllocate;
+	if (config.policy == NULL) {
+		printf("Error snapshot %s uses the unknown policy %s.\n", path, header.policy);
+		exit(EXIT_FAILURE);
+	}
+
+	if (createCache(cache, &config) != 0) {
+		printf("Error could not allocate the cache of snapshot %s.\n", path);
+		exit(EXIT_FAILURE);
+	}
+	if (header.storageSize != cache->setStride * cache->numSets
+			|| fread(cache->storage, 1, header.storageSize, file) != header.storageSize) {
+		printf("Error snapshot %s is truncated or was written by another version of csim.\n", path);
+		exit(EXIT_FAILURE);
+	}
+	fclose(file);
+
+	cache->hits = header.hits;
+	cache->misses = header.misses;
+	cache->evictions = header.evictions;
+	cache->writebacks = header.writebacks;
+	cache->fillBytes = header.fillBytes;
+	cache->writebackBytes = header.writebackBytes;
+	cache->directWriteBytes = header.directWriteBytes;
+	*splitAccesses = header.splitAccesses;
+	*position = header.position;
+}
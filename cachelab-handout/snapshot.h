@@ -0,0 +1,60 @@
+/*
+ * snapshot.h - Saving and restoring the state of a simulated cache
+ *
+ * A snapshot holds everything needed to carry on a simulation exactly
+ * where it stopped: the configuration of the cache, its counters, the
+ * per set block of tags, valid and dirty bits, policy state and tag
+ * index, and how far into the trace the simulation got. The policies
+ * and the index keep their state as plain indices and bits, so the set
+ * blocks are written out as they are. The file is native endian and
+ * only meant to be read back on the machine that wrote it:
+ *
+ *     "CSIMSNP1"  magic
+ *     header      struct snapshotHeader
+ *     storage     setStride * numSets bytes of set blocks
+ *
+ * The trace position is kept both as a record count and, for traces
+ * that are mapped rather than streamed, as a byte offset. Resuming from
+ * a mapped trace jumps straight to the offset, while a streamed trace is
+ * read and discarded up to the record count.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "cache.h"
+
+#define SNAPSHOT_MAGIC "CSIMSNP1"
+#define SNAPSHOT_MAGIC_LENGTH 8
+
+// How far into the trace a simulation got.
+struct tracePosition {
+	unsigned long long records;
+	long long offset;           // Byte offset of the next record, or -1 if the trace was streamed.
+	unsigned long long lastAddr;
+};
+
+struct snapshotHeader {
+	int numSetIndexBits;
+	int numLines;
+	int blockSize;
+	char policy[16];
+	int writeThrough;
+	int noWriteAllocate;
+	int splitAccesses;
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evictions;
+	unsigned long long writebacks;
+	unsigned long long fillBytes;
+	unsigned long long writebackBytes;
+	unsigned long long directWriteBytes;
+	struct tracePosition position;
+	unsigned long long storageSize;
+};
+
+void saveSnapshot(const char *path, const struct cache *cache, int splitAccesses,
+		const struct tracePosition *position);
+void loadSnapshot(const char *path, struct cache *cache, int *splitAccesses, struct tracePosition *position);
+
+#endif /* SNAPSHOT_H */
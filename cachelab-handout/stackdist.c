@@ -0,0 +1,270 @@
+/*
+ * stackdist.c - LRU stack distance analysis
+ */
+
+#include "stackdist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_SET_CAPACITY 16
+#define INITIAL_TABLE_SIZE   1024
+
+static void *allocOrDie(size_t size) {
+	void *ptr = calloc(1, size);
+	if (ptr == NULL) {
+		printf("Error out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	return ptr;
+}
+
+void createStackDist(struct stackDist *sd, int numSetIndexBits, int blockSize, int maxLines) {
+	memset(sd, 0, sizeof(*sd));
+	sd->numSetIndexBits = numSetIndexBits;
+	sd->blockSize = blockSize;
+	sd->maxLines = maxLines;
+	sd->sets = allocOrDie((1ULL << numSetIndexBits) * sizeof(struct stackDistSet));
+	sd->tableSize = INITIAL_TABLE_SIZE;
+	sd->table = allocOrDie(sd->tableSize * sizeof(struct stackDistEntry));
+
+	if (maxLines > 0) {
+		sd->distHist = allocOrDie((maxLines + 1) * sizeof(unsigned long long));
+		sd->coldHist = allocOrDie((maxLines + 1) * sizeof(unsigned long long));
+	}
+}
+
+void freeStackDist(struct stackDist *sd) {
+	for (unsigned long long set = 0; set < (1ULL << sd->numSetIndexBits); set++) {
+		free(sd->sets[set].tree);
+		free(sd->sets[set].owner);
+	}
+	free(sd->sets);
+	free(sd->table);
+	free(sd->distHist);
+	free(sd->coldHist);
+	memset(sd, 0, sizeof(*sd));
+}
+
+// Bound the number of blocks remembered. Only a single set is supported, since the block to forget must be the least
+// recently used one overall.
+void setStackDistLimit(struct stackDist *sd, unsigned long long maxBlocks) {
+	if (sd->numSetIndexBits != 0) {
+		printf("Error only a single set stack distance engine can be limited.\n");
+		exit(EXIT_FAILURE);
+	}
+	sd->maxBlocks = maxBlocks;
+}
+
+// Fenwick tree over set local time: add delta to the mark at time t.
+static void treeAdd(struct stackDistSet *set, int t, int delta) {
+	for (int i = t + 1; i <= set->capacity; i += i & -i) {
+		set->tree[i] += delta;
+	}
+}
+
+// Number of marked times strictly before t.
+static int treeSum(const struct stackDistSet *set, int t) {
+	int sum = 0;
+	for (int i = t; i > 0; i -= i & -i) {
+		sum += set->tree[i];
+	}
+	return sum;
+}
+
+// Rebuild the Fenwick tree from the owner array in linear time.
+static void rebuildTree(struct stackDistSet *set) {
+	for (int i = 1; i <= set->capacity; i++) {
+		set->tree[i] = set->owner[i - 1] >= 0;
+	}
+	for (int i = 1; i <= set->capacity; i++) {
+		int parent = i + (i & -i);
+		if (parent <= set->capacity) {
+			set->tree[parent] += set->tree[i];
+		}
+	}
+}
+
+// Called when a set has used up its timeline. If at most half of it is still live, the live blocks are renumbered to
+// the front; otherwise the timeline doubles. Either way the work is paid for by the accesses that filled it, and the
+// memory stays proportional to the number of distinct blocks rather than the length of the trace.
+static void makeRoom(struct stackDist *sd, struct stackDistSet *set) {
+	if (set->capacity > 0 && set->live * 2 <= set->capacity) {
+		int next = 0;
+		for (int t = 0; t < set->now; t++) {
+			if (set->owner[t] >= 0) {
+				set->owner[next] = set->owner[t];
+				sd->table[set->owner[next]].time = next + 1;
+				next++;
+			}
+		}
+		for (int t = next; t < set->capacity; t++) {
+			set->owner[t] = -1;
+		}
+		set->now = next;
+		set->oldest = 0;
+	} else {
+		int capacity = set->capacity ? set->capacity * 2 : INITIAL_SET_CAPACITY;
+		set->owner = realloc(set->owner, capacity * sizeof(int));
+		set->tree = realloc(set->tree, (capacity + 1) * sizeof(int));
+		if (set->owner == NULL || set->tree == NULL) {
+			printf("Error out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		for (int t = set->capacity; t < capacity; t++) {
+			set->owner[t] = -1;
+		}
+		set->capacity = capacity;
+	}
+	rebuildTree(set);
+}
+
+static unsigned long long hashBlock(unsigned long long block, unsigned long long tableSize) {
+	return (block * 0x9E3779B97F4A7C15ULL) >> 17 & (tableSize - 1);
+}
+
+// Double the block table. Entries move, so the owner slots of every set are rewritten to follow them.
+static void growTable(struct stackDist *sd) {
+	struct stackDistEntry *old = sd->table;
+	unsigned long long oldSize = sd->tableSize;
+	unsigned long long setMask = (1ULL << sd->numSetIndexBits) - 1;
+
+	sd->tableSize *= 2;
+	sd->table = allocOrDie(sd->tableSize * sizeof(struct stackDistEntry));
+
+	for (unsigned long long i = 0; i < oldSize; i++) {
+		if (old[i].time == 0) {
+			continue;
+		}
+		unsigned long long slot = hashBlock(old[i].block, sd->tableSize);
+		while (sd->table[slot].time != 0) {
+			slot = (slot + 1) & (sd->tableSize - 1);
+		}
+		sd->table[slot] = old[i];
+		sd->sets[old[i].block & setMask].owner[old[i].time - 1] = slot;
+	}
+	free(old);
+}
+
+// Find the entry of a block, creating an empty one if this is its first touch.
+static unsigned long long findBlock(struct stackDist *sd, unsigned long long block) {
+	if ((sd->tableUsed + 1) * 2 > sd->tableSize) {
+		growTable(sd);
+	}
+
+	unsigned long long slot = hashBlock(block, sd->tableSize);
+	while (sd->table[slot].time != 0) {
+		if (sd->table[slot].block == block) {
+			return slot;
+		}
+		slot = (slot + 1) & (sd->tableSize - 1);
+	}
+	sd->table[slot].block = block;
+	sd->tableUsed++;
+	return slot;
+}
+
+// Remove the entry in slot from the block table. Later entries of the same probe run shift back into the hole, so that
+// lookups never stop early at it, and their owner slots follow them.
+static void removeBlock(struct stackDist *sd, unsigned long long slot) {
+	unsigned long long mask = sd->tableSize - 1;
+	unsigned long long setMask = (1ULL << sd->numSetIndexBits) - 1;
+	unsigned long long hole = slot;
+
+	sd->tableUsed--;
+	for (;;) {
+		unsigned long long next = hole;
+
+		sd->table[hole].time = 0;
+		for (;;) {
+			next = (next + 1) & mask;
+			if (sd->table[next].time == 0) {
+				return;
+			}
+
+			// An entry can move back only if its home slot does not lie cyclically within (hole, next].
+			unsigned long long home = hashBlock(sd->table[next].block, sd->tableSize);
+			int stays = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+			if (!stays) {
+				break;
+			}
+		}
+
+		sd->table[hole] = sd->table[next];
+		sd->sets[sd->table[hole].block & setMask].owner[sd->table[hole].time - 1] = hole;
+		hole = next;
+	}
+}
+
+// Forget the least recently used block of the single set.
+static void forgetOldest(struct stackDist *sd) {
+	struct stackDistSet *set = &sd->sets[0];
+
+	while (set->owner[set->oldest] < 0) {
+		set->oldest++;
+	}
+
+	int t = set->oldest;
+	unsigned long long slot = set->owner[t];
+	treeAdd(set, t, -1);
+	set->owner[t] = -1;
+	set->live--;
+	removeBlock(sd, slot);
+	sd->forgotten++;
+}
+
+// Record one access and return its stack distance, or STACKDIST_COLD for the first touch of a block.
+long long accessStackDist(struct stackDist *sd, unsigned long long memAddr) {
+	unsigned long long block = memAddr >> sd->blockSize;
+	struct stackDistSet *set = &sd->sets[block & ((1ULL << sd->numSetIndexBits) - 1)];
+	unsigned long long slot = findBlock(sd, block);
+	long long distance;
+
+	if (set->now == set->capacity) {
+		makeRoom(sd, set);
+	}
+
+	sd->accesses++;
+	if (sd->table[slot].time == 0) {
+		distance = STACKDIST_COLD;
+		sd->cold++;
+		if (sd->maxLines > 0) {
+			sd->coldHist[set->live < sd->maxLines ? set->live : sd->maxLines]++;
+		}
+		set->live++;
+	} else {
+		int last = sd->table[slot].time - 1;
+		distance = treeSum(set, set->now) - treeSum(set, last + 1);
+		if (sd->maxLines > 0) {
+			sd->distHist[distance < sd->maxLines ? distance : sd->maxLines]++;
+		}
+		treeAdd(set, last, -1);
+		set->owner[last] = -1;
+	}
+
+	treeAdd(set, set->now, 1);
+	set->owner[set->now] = slot;
+	sd->table[slot].time = ++set->now;
+
+	if (sd->maxBlocks > 0 && sd->tableUsed > sd->maxBlocks) {
+		forgetOldest(sd);
+	}
+	return distance;
+}
+
+// Derive the totals an LRU cache with numLines ways would have produced. An access misses when its distance is at least
+// numLines. A miss evicts unless it is a first touch into a set that still had a free line.
+void stackDistResults(const struct stackDist *sd, int numLines, unsigned long long *hits, unsigned long long *misses,
+		unsigned long long *evictions) {
+	unsigned long long far = 0;
+	unsigned long long coldEvictions = 0;
+
+	for (int d = numLines; d <= sd->maxLines; d++) {
+		far += sd->distHist[d];
+		coldEvictions += sd->coldHist[d];
+	}
+
+	*misses = sd->cold + far;
+	*hits = sd->accesses - *misses;
+	*evictions = far + coldEvictions;
+}
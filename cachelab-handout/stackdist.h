@@ -0,0 +1,68 @@
+/*
+ * stackdist.h - LRU stack distance analysis
+ *
+ * For a fixed number of sets and block size, the LRU stack distance of
+ * an access is the number of distinct blocks of the same set touched
+ * since the previous access to its block. An access hits in an E way
+ * LRU cache exactly when its distance is below E, so one pass over a
+ * trace gives the miss count of every associativity at once (Mattson
+ * et al., 1970). Distances are found with a Fenwick tree per set over
+ * the times at which each resident block was last touched, so an
+ * access costs O(log n) no matter how large the distance is.
+ *
+ * Memory grows with the number of distinct blocks. For a single set it
+ * can be bounded with setStackDistLimit, which forgets the least
+ * recently used block whenever more than maxBlocks are tracked. A block
+ * that returns after being forgotten looks like a first touch, so cold
+ * then counts both kinds of access.
+ */
+
+#ifndef STACKDIST_H
+#define STACKDIST_H
+
+// Per set bookkeeping. Slot t of owner holds the hash entry of the block last touched at set local time t, or -1.
+struct stackDistSet {
+	int *tree;
+	int *owner;
+	int capacity;
+	int now;
+	int live;
+	int oldest;                 // No live block was last touched before this time.
+};
+
+// Location of a block's most recent access, keyed by block number.
+struct stackDistEntry {
+	unsigned long long block;
+	int time;                   // Set local time of the last access plus one, 0 for an empty entry.
+};
+
+struct stackDist {
+	int numSetIndexBits;
+	int blockSize;
+	int maxLines;
+	struct stackDistSet *sets;
+	struct stackDistEntry *table;
+	unsigned long long tableSize;
+	unsigned long long tableUsed;
+
+	// Distance histograms up to maxLines, with everything beyond folded into the last bucket. coldHist counts first
+	// touches by how many blocks the set already held, which decides whether they evict.
+	unsigned long long *distHist;
+	unsigned long long *coldHist;
+	unsigned long long accesses;
+	unsigned long long cold;
+
+	unsigned long long maxBlocks;   // 0 if every block is remembered.
+	unsigned long long forgotten;   // Blocks dropped to stay within maxBlocks.
+};
+
+#define STACKDIST_COLD (-1LL)
+
+void createStackDist(struct stackDist *sd, int numSetIndexBits, int blockSize, int maxLines);
+void freeStackDist(struct stackDist *sd);
+void setStackDistLimit(struct stackDist *sd, unsigned long long maxBlocks);
+long long accessStackDist(struct stackDist *sd, unsigned long long memAddr);
+void stackDistResults(const struct stackDist *sd, int numLines, unsigned long long *hits, unsigned long long *misses,
+		unsigned long long *evictions);
+
+#endif /* STACKDIST_H */
@@ -6,3 +6,13 @@
  ./csim -s 2 -E 4 -b 3 -t traces/trans.trace
  ./csim -s 5 -E 1 -b 5 -t traces/trans.trace
  ./csim -s 5 -E 1 -b 5 -t traces/long.trace
+ # wide.trace has addresses above 4GB, where csim must still agree with csim-ref
+ for geometry in "-s 2 -E 2 -b 4" "-s 4 -E 1 -b 5"; do
+     result=$(./csim $geometry -t traces/wide.trace)
+     expected=$(./csim-ref $geometry -t traces/wide.trace)
+     echo "$result"
+     if [ "$result" != "$expected" ]; then
+         echo "Mismatch on traces/wide.trace ($geometry): csim-ref gives $expected"
+         exit 1
+     fi
+ done
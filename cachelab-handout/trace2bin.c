@@ -0,0 +1,107 @@
+/*
+ * trace2bin.c - Convert lackey text traces into the compact binary trace
+ *     format described in traceio.h, so that repeated simulations of the
+ *     same trace skip text parsing entirely.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include "traceio.h"
+
+/*
+ * usage - Print usage info
+ */
+void usage(char *argv[]) {
+    printf("Usage: %s [-h] [-o <output>] <trace>...\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h           Print this help message.\n");
+    printf("  -o <output>  Output file name (only with a single trace).\n");
+    printf("Each trace is written to <trace>.bin unless -o is given.\n");
+    printf("Example: %s traces/long.trace\n", argv[0]);
+}
+
+/*
+ * convert - Convert one trace, returning the number of records written
+ */
+long convert(const char *input, const char *output)
+{
+    struct traceReader reader;
+    struct traceWriter writer;
+    struct traceRecord rec;
+    long records = 0;
+
+    openTrace(&reader, input);
+    if (reader.binary) {
+        printf("Error: %s is already a binary trace\n", input);
+        exit(1);
+    }
+
+    FILE *out_fp = fopen(output, "wb");
+    if (out_fp == NULL) {
+        printf("Error: could not create %s\n", output);
+        exit(1);
+    }
+
+    openTraceWriter(&writer, out_fp);
+    while (readRecord(&reader, &rec)) {
+        if (rec.op != 'L' && rec.op != 'S' && rec.op != 'M') {
+            printf("Warning: skipping unknown record \"%.*s\" in %s\n",
+                   rec.textLength, rec.text, input);
+            continue;
+        }
+        writeRecord(&writer, &rec);
+        records++;
+    }
+
+    /* A failed write may only show up when the buffered tail is flushed */
+    int failed = ferror(out_fp);
+    if (fclose(out_fp) != 0 || failed) {
+        struct stat info;
+        printf("Error: could not write %s\n", output);
+        if (stat(output, &info) == 0 && S_ISREG(info.st_mode)) {
+            remove(output);
+        }
+        exit(1);
+    }
+    closeTrace(&reader);
+    return records;
+}
+
+int main(int argc, char *argv[])
+{
+    char *output = NULL;
+    char c;
+
+    while ((c = getopt(argc, argv, "o:h")) != -1) {
+        switch (c) {
+        case 'o':
+            output = optarg;
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    if (optind == argc || (output != NULL && argc - optind > 1)) {
+        usage(argv);
+        exit(1);
+    }
+
+    for (int i = optind; i < argc; i++) {
+        char name[4096];
+        if (output == NULL) {
+            snprintf(name, sizeof(name), "%s.bin", argv[i]);
+        } else {
+            snprintf(name, sizeof(name), "%s", output);
+        }
+        long records = convert(argv[i], name);
+        printf("%s: %ld records -> %s\n", argv[i], records, name);
+    }
+    return 0;
+}
@@ -0,0 +1,692 @@
+/*
+ * traceio.c - Reading and writing memory traces for the cache simulator
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "traceio.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+static const char opCodes[] = "LSM";
+
+// Compressed formats, recognized by their magic bytes and undone by the named tool.
+struct compression {
+	const char *magic;
+	int length;
+	const char *tool;
+};
+
+static const struct compression compressions[] = {
+	{"\x1f\x8b", 2, "gzip"},
+	{"\x28\xb5\x2f\xfd", 4, "zstd"},
+	{"\xfd\x37\x7a\x58\x5a\x00", 6, "xz"},
+};
+
+#define MAX_MAGIC_LENGTH 8
+
+// Lookup table from an ASCII character to its hexadecimal digit value, or -1 if the character is not a hex digit.
+static signed char hexValue[256];
+static int hexTableReady = 0;
+
+static void initHexTable() {
+	memset(hexValue, -1, sizeof(hexValue));
+	for (int digit = 0; digit < 10; digit++) {
+		hexValue['0' + digit] = digit;
+	}
+	for (int digit = 0; digit < 6; digit++) {
+		hexValue['a' + digit] = 10 + digit;
+		hexValue['A' + digit] = 10 + digit;
+	}
+	hexTableReady = 1;
+}
+
+// Move the bytes not decoded yet to the front of the buffer, and read more of the stream after them. The buffer grows
+// if a single line does not fit.
+static void refillTrace(struct traceReader *reader) {
+	size_t left = reader->filled - reader->pos;
+
+	memmove(reader->buffer, reader->pos, left);
+	if (left == reader->capacity) {
+		reader->capacity *= 2;
+		reader->buffer = realloc(reader->buffer, reader->capacity);
+		if (reader->buffer == NULL) {
+			printf("Error could not allocate the trace buffer.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	ssize_t count;
+	do {
+		count = read(reader->fd, reader->buffer + left, reader->capacity - left);
+	} while (count < 0 && errno == EINTR);
+	if (count < 0) {
+		printf("Error could not read file.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (count == 0) {
+		reader->eof = 1;
+	}
+
+	reader->data = reader->buffer;
+	reader->pos = reader->buffer;
+	reader->filled = reader->buffer + left + count;
+	reader->end = reader->filled;
+}
+
+// Return the compression whose magic bytes start data, or NULL if the data is not compressed.
+static const struct compression *findCompression(const char *data, size_t length) {
+	for (size_t i = 0; i < sizeof(compressions) / sizeof(compressions[0]); i++) {
+		if (length >= compressions[i].length && memcmp(data, compressions[i].magic, compressions[i].length) == 0) {
+			return &compressions[i];
+		}
+	}
+	return NULL;
+}
+
+// Start the decompressor reading from inputFd, and stream the trace from its output from here on.
+static void startDecompressor(struct traceReader *reader, const struct compression *compression, int inputFd) {
+	int output[2];
+
+	if (pipe(output) < 0) {
+		printf("Error could not start the decompressor.\n");
+		exit(EXIT_FAILURE);
+	}
+	fcntl(output[0], F_SETFD, FD_CLOEXEC);
+
+	// A decompressor that dies early must not take csim down with it; its exit status is checked in closeTrace.
+	signal(SIGPIPE, SIG_IGN);
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		printf("Error could not start the decompressor.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (pid == 0) {
+		signal(SIGPIPE, SIG_DFL);
+		dup2(inputFd, STDIN_FILENO);
+		dup2(output[1], STDOUT_FILENO);
+		close(output[1]);
+		execlp(compression->tool, compression->tool, "-dc", (char *)NULL);
+		fprintf(stderr, "Error could not run %s.\n", compression->tool);
+		_exit(127);
+	}
+
+	close(output[1]);
+	if (inputFd != STDIN_FILENO) {
+		close(inputFd);
+	}
+	reader->decompressor = pid;
+	reader->fd = output[0];
+}
+
+// Write the whole buffer to a pipe, returning 0 if the reader went away.
+static int writeAll(int fd, const char *data, size_t length) {
+	while (length > 0) {
+		ssize_t count = write(fd, data, length);
+		if (count < 0 && errno == EINTR) {
+			continue;
+		}
+		if (count <= 0) {
+			return 0;
+		}
+		data += count;
+		length -= count;
+	}
+	return 1;
+}
+
+// Copy the compressed bytes already read, then the rest of the source, to the decompressor.
+static void *feedDecompressor(void *arg) {
+	struct traceReader *reader = arg;
+	char block[1 << 16];
+	int open = writeAll(reader->feedFd, reader->prefix, reader->prefixLength);
+
+	while (open) {
+		ssize_t count = read(reader->sourceFd, block, sizeof(block));
+		if (count < 0 && errno == EINTR) {
+			continue;
+		}
+		if (count <= 0) {
+			break;
+		}
+		open = writeAll(reader->feedFd, block, count);
+	}
+	close(reader->feedFd);
+	return NULL;
+}
+
+// A compressed trace arrived through a pipe, and its first bytes are already in the buffer. Hand them and the rest of
+// the pipe to the decompressor through a feeder thread, and restart the buffer on the decompressed stream.
+static void startFeeder(struct traceReader *reader, const struct compression *compression) {
+	int input[2];
+
+	if (pipe(input) < 0) {
+		printf("Error could not start the decompressor.\n");
+		exit(EXIT_FAILURE);
+	}
+	fcntl(input[1], F_SETFD, FD_CLOEXEC);
+
+	reader->sourceFd = reader->fd;
+	reader->feedFd = input[1];
+	reader->prefixLength = reader->filled - reader->buffer;
+	reader->prefix = malloc(reader->prefixLength);
+	if (reader->prefix == NULL) {
+		printf("Error could not allocate the trace buffer.\n");
+		exit(EXIT_FAILURE);
+	}
+	memcpy(reader->prefix, reader->buffer, reader->prefixLength);
+
+	startDecompressor(reader, compression, input[0]);
+	close(input[0]);
+	if (pthread_create(&reader->feeder, NULL, feedDecompressor, reader) != 0) {
+		printf("Error could not start the decompressor.\n");
+		exit(EXIT_FAILURE);
+	}
+	reader->feeding = 1;
+
+	reader->pos = reader->filled = reader->buffer;
+	reader->eof = 0;
+}
+
+// Hold back a partial last line of a streamed text trace until the rest of it has been read.
+static void holdPartialLine(struct traceReader *reader) {
+	if (reader->streaming && !reader->binary && !reader->eof) {
+		const char *end = reader->filled;
+		while (end > reader->pos && end[-1] != '\n') {
+			end--;
+		}
+		reader->end = end;
+	}
+}
+
+// Map the whole trace file into memory so that it can be parsed in place, and detect its format from the magic bytes.
+// Stdin, given as "-", pipes and other files that cannot be mapped are streamed through a buffer instead.
+void openTrace(struct traceReader *reader, const char *path) {
+	int fd = (strcmp(path, "-") == 0) ? STDIN_FILENO : open(path, O_RDONLY);
+
+	if (fd < 0) {
+		printf("Error could not open file.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		printf("Error could not read file.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	memset(reader, 0, sizeof(*reader));
+
+	// A compressed file is streamed through its decompressor rather than mapped.
+	int mapped = S_ISREG(st.st_mode);
+	if (mapped) {
+		char magic[MAX_MAGIC_LENGTH];
+		ssize_t count = pread(fd, magic, sizeof(magic), 0);
+		const struct compression *compression = findCompression(magic, count > 0 ? count : 0);
+		if (compression != NULL) {
+			startDecompressor(reader, compression, fd);
+			fd = reader->fd;
+			mapped = 0;
+		}
+	}
+
+	if (mapped) {
+		reader->size = st.st_size;
+
+		// An empty file has nothing to map and simply yields no records.
+		if (st.st_size > 0) {
+			void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (map == MAP_FAILED) {
+				printf("Error could not map file.\n");
+				exit(EXIT_FAILURE);
+			}
+
+			// Traces are consumed front to back exactly once, so let the kernel read ahead aggressively.
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			reader->data = map;
+		}
+		if (fd != STDIN_FILENO) {
+			close(fd);
+		}
+
+		reader->pos = reader->data;
+		reader->end = reader->data + reader->size;
+	} else {
+		reader->streaming = 1;
+		reader->fd = fd;
+		reader->capacity = TRACE_BUFFER_SIZE;
+		reader->buffer = malloc(reader->capacity);
+		if (reader->buffer == NULL) {
+			printf("Error could not allocate the trace buffer.\n");
+			exit(EXIT_FAILURE);
+		}
+		reader->pos = reader->filled = reader->buffer;
+		while (!reader->eof && reader->filled - reader->pos < MAX_MAGIC_LENGTH) {
+			refillTrace(reader);
+		}
+
+		const struct compression *compression = findCompression(reader->pos, reader->filled - reader->pos);
+		if (reader->decompressor == 0 && compression != NULL) {
+			startFeeder(reader, compression);
+			while (!reader->eof && reader->filled - reader->pos < MAX_MAGIC_LENGTH) {
+				refillTrace(reader);
+			}
+		}
+	}
+
+	if (reader->end - reader->pos >= TRACE_MAGIC_LENGTH && memcmp(reader->pos, TRACE_MAGIC, TRACE_MAGIC_LENGTH) == 0) {
+		reader->binary = 1;
+		reader->pos += TRACE_MAGIC_LENGTH;
+	}
+	holdPartialLine(reader);
+
+	if (!hexTableReady) {
+		initHexTable();
+	}
+}
+
+void closeTrace(struct traceReader *reader) {
+	struct tracePipeline *pipeline = reader->pipeline;
+
+	if (pipeline != NULL) {
+		pthread_mutex_lock(&pipeline->lock);
+		pipeline->stopping = 1;
+		pthread_cond_broadcast(&pipeline->released);
+		pthread_mutex_unlock(&pipeline->lock);
+		for (int thread = 0; thread < pipeline->numThreads; thread++) {
+			pthread_join(pipeline->threads[thread], NULL);
+		}
+		for (int slot = 0; slot < pipeline->numSlots; slot++) {
+			free(pipeline->slots[slot].records);
+		}
+		pthread_mutex_destroy(&pipeline->lock);
+		pthread_cond_destroy(&pipeline->parsed);
+		pthread_cond_destroy(&pipeline->released);
+		free(pipeline->slots);
+		free(pipeline);
+		reader->pipeline = NULL;
+		reader->chunk = NULL;
+	}
+	if (reader->streaming) {
+		free(reader->buffer);
+		if (reader->fd != STDIN_FILENO) {
+			close(reader->fd);
+		}
+		reader->buffer = NULL;
+	} else if (reader->data != NULL) {
+		munmap((void *)reader->data, reader->size);
+	}
+	if (reader->feeding) {
+		pthread_join(reader->feeder, NULL);
+		if (reader->sourceFd != STDIN_FILENO) {
+			close(reader->sourceFd);
+		}
+		free(reader->prefix);
+		reader->feeding = 0;
+	}
+	if (reader->decompressor != 0) {
+		int status;
+		waitpid(reader->decompressor, &status, 0);
+		reader->decompressor = 0;
+
+		// A decompressor stopped before the end of its output only saw its pipe close, which is not an error.
+		if (reader->eof && !(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+			printf("Error could not decompress the trace.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	reader->data = reader->pos = reader->end = NULL;
+}
+
+// The offset of the next record within a mapped trace, or -1 for a streamed trace, which cannot be sought back into.
+long long traceOffset(const struct traceReader *reader) {
+	if (reader->streaming) {
+		return -1;
+	}
+	if (reader->pipeline != NULL) {
+		if (reader->lastText == NULL) {
+			return reader->pipeline->base - reader->data;
+		}
+		const char *eol = memchr(reader->lastText, '\n', reader->end - reader->lastText);
+		return (eol != NULL) ? eol + 1 - reader->data : (long long)reader->size;
+	}
+	return reader->pos - reader->data;
+}
+
+// Continue a mapped trace from an offset returned by traceOffset. Binary traces also need the address the next delta is
+// taken from. This must happen before any parser threads are started.
+void seekTrace(struct traceReader *reader, long long offset, unsigned long long lastAddr) {
+	if (reader->streaming || reader->pipeline != NULL || offset < 0 || offset > (long long)reader->size) {
+		printf("Error cannot seek in this trace.\n");
+		exit(EXIT_FAILURE);
+	}
+	reader->pos = reader->data + offset;
+	reader->lastAddr = lastAddr;
+}
+
+// Decode one " L 00602260,4" line, skipping instruction fetches and blank lines. The address and size are parsed by hand
+// straight out of the mapping, which avoids copying every line through stdio and re-scanning it with sscanf.
+static int readTextRecord(struct traceReader *reader, struct traceRecord *rec) {
+	const char *pos = reader->pos;
+	const char *end = reader->end;
+
+	while (pos < end) {
+		const char *eol = memchr(pos, '\n', end - pos);
+		if (eol == NULL) {
+			eol = end;
+		}
+
+		// Instruction loads do not touch the data cache.
+		if (*pos == 'I') {
+			pos = eol + 1;
+			continue;
+		}
+
+		while (pos < eol && (*pos == ' ' || *pos == '\t')) {
+			pos++;
+		}
+		if (pos == eol) {
+			pos = eol + 1;
+			continue;
+		}
+
+		rec->text = pos;
+		rec->textLength = eol - pos;
+		if (rec->textLength > 0 && pos[rec->textLength - 1] == '\r') {
+			rec->textLength--;
+		}
+
+		rec->op = *pos++;
+		while (pos < eol && (*pos == ' ' || *pos == '\t')) {
+			pos++;
+		}
+
+		unsigned long long addr = 0;
+		while (pos < eol && hexValue[(unsigned char)*pos] >= 0) {
+			addr = (addr << 4) | hexValue[(unsigned char)*pos];
+			pos++;
+		}
+		rec->addr = addr;
+
+		unsigned int size = 0;
+		if (pos < eol && *pos == ',') {
+			pos++;
+			while (pos < eol && *pos >= '0' && *pos <= '9') {
+				size = size * 10 + (*pos - '0');
+				pos++;
+			}
+		}
+		rec->size = size;
+
+		reader->pos = eol + 1;
+		return 1;
+	}
+
+	reader->pos = end;
+	return 0;
+}
+
+// Decode a little endian base 128 varint, or exit if the trace ends in the middle of one.
+static unsigned long long readVarint(struct traceReader *reader) {
+	unsigned long long value = 0;
+	int shift = 0;
+
+	while (reader->pos < reader->end && shift < 64) {
+		unsigned char byte = *reader->pos++;
+		value |= (unsigned long long)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return value;
+		}
+		shift += 7;
+	}
+
+	printf("Error truncated binary trace.\n");
+	exit(EXIT_FAILURE);
+}
+
+static int readBinaryRecord(struct traceReader *reader, struct traceRecord *rec) {
+	if (reader->pos >= reader->end) {
+		return 0;
+	}
+
+	unsigned char header = *reader->pos++;
+	if ((header & 3) == 3) {
+		printf("Error corrupt binary trace.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	rec->op = opCodes[header & 3];
+	rec->size = header >> 2;
+	if (rec->size == 63) {
+		rec->size = readVarint(reader);
+	}
+
+	unsigned long long zigzag = readVarint(reader);
+	unsigned long long delta = (zigzag >> 1) ^ -(zigzag & 1);
+	reader->lastAddr += delta;
+	rec->addr = reader->lastAddr;
+	rec->text = NULL;
+	rec->textLength = 0;
+	return 1;
+}
+
+// Parse the records of one chunk into its slot. Parsing starts at the beginning of the line holding the first byte of the
+// chunk, and keeps the records whose operation lies within the chunk. Chunks are counted from where the reader stood when
+// the parsers started, which is always the start of a line.
+static void parseChunk(const struct traceReader *reader, struct traceChunk *chunk) {
+	struct traceReader local;
+	struct traceRecord rec;
+	const char *base = reader->pipeline->base;
+	size_t offset = chunk->index * (size_t)TRACE_CHUNK_SIZE;
+	size_t remaining = reader->end - base - offset;
+	const char *start = base + offset;
+	const char *limit = start + (remaining < TRACE_CHUNK_SIZE ? remaining : TRACE_CHUNK_SIZE);
+
+	memset(&local, 0, sizeof(local));
+	local.data = reader->data;
+	local.pos = start;
+	local.end = reader->end;
+	while (local.pos > base && local.pos[-1] != '\n') {
+		local.pos--;
+	}
+
+	chunk->count = 0;
+	while (readTextRecord(&local, &rec)) {
+		if (rec.text < start) {
+			continue;
+		}
+		if (rec.text >= limit) {
+			break;
+		}
+		if (chunk->count == chunk->capacity) {
+			chunk->capacity = chunk->capacity ? chunk->capacity * 2 : 4096;
+			chunk->records = realloc(chunk->records, chunk->capacity * sizeof(struct traceRecord));
+			if (chunk->records == NULL) {
+				printf("Error could not allocate trace records.\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		chunk->records[chunk->count++] = rec;
+	}
+}
+
+// Claim chunks in file order and parse them, never getting more than a ring's length ahead of the consumer.
+static void *runParser(void *arg) {
+	const struct traceReader *reader = arg;
+	struct tracePipeline *pipeline = reader->pipeline;
+
+	pthread_mutex_lock(&pipeline->lock);
+	while (!pipeline->stopping && pipeline->nextChunk < pipeline->numChunks) {
+		long long index = pipeline->nextChunk++;
+
+		while (!pipeline->stopping && index - pipeline->consumed >= pipeline->numSlots) {
+			pthread_cond_wait(&pipeline->released, &pipeline->lock);
+		}
+		if (pipeline->stopping) {
+			break;
+		}
+
+		struct traceChunk *chunk = &pipeline->slots[index % pipeline->numSlots];
+		chunk->index = index;
+		chunk->ready = 0;
+		pthread_mutex_unlock(&pipeline->lock);
+
+		parseChunk(reader, chunk);
+
+		pthread_mutex_lock(&pipeline->lock);
+		chunk->ready = 1;
+		pthread_cond_broadcast(&pipeline->parsed);
+	}
+	pthread_mutex_unlock(&pipeline->lock);
+	return NULL;
+}
+
+// Parse a text trace on numThreads threads from here on. Binary traces and traces that fit in one chunk are left to
+// the calling thread, since there is nothing to gain from splitting them.
+void startTraceParsers(struct traceReader *reader, int numThreads) {
+	if (reader->binary || reader->streaming || reader->end - reader->pos <= TRACE_CHUNK_SIZE || numThreads < 1) {
+		return;
+	}
+	if (numThreads > MAX_PARSERS) {
+		numThreads = MAX_PARSERS;
+	}
+
+	struct tracePipeline *pipeline = calloc(1, sizeof(struct tracePipeline));
+	if (pipeline == NULL) {
+		printf("Error could not allocate the trace parsers.\n");
+		exit(EXIT_FAILURE);
+	}
+	pipeline->base = reader->pos;
+	pipeline->numChunks = (reader->end - reader->pos + TRACE_CHUNK_SIZE - 1) / TRACE_CHUNK_SIZE;
+	pipeline->numSlots = 2 * numThreads;
+	pipeline->slots = calloc(pipeline->numSlots, sizeof(struct traceChunk));
+	if (pipeline->slots == NULL) {
+		printf("Error could not allocate the trace parsers.\n");
+		exit(EXIT_FAILURE);
+	}
+	for (int slot = 0; slot < pipeline->numSlots; slot++) {
+		pipeline->slots[slot].index = -1;
+	}
+	pthread_mutex_init(&pipeline->lock, NULL);
+	pthread_cond_init(&pipeline->parsed, NULL);
+	pthread_cond_init(&pipeline->released, NULL);
+	reader->pipeline = pipeline;
+
+	for (int thread = 0; thread < numThreads; thread++) {
+		if (pthread_create(&pipeline->threads[thread], NULL, runParser, reader) != 0) {
+			printf("Error could not start a parser thread.\n");
+			exit(EXIT_FAILURE);
+		}
+		pipeline->numThreads++;
+	}
+}
+
+// Hand out the records of the parsed chunks in file order, giving each chunk back to the parsers once it is used up.
+static int readParsedRecord(struct traceReader *reader, struct traceRecord *rec) {
+	struct tracePipeline *pipeline = reader->pipeline;
+
+	while (reader->chunk == NULL || reader->chunkPos == reader->chunk->count) {
+		pthread_mutex_lock(&pipeline->lock);
+		if (reader->chunk != NULL) {
+			reader->chunk->index = -1;
+			reader->chunk = NULL;
+			pipeline->consumed++;
+			pthread_cond_broadcast(&pipeline->released);
+		}
+		if (pipeline->consumed == pipeline->numChunks) {
+			pthread_mutex_unlock(&pipeline->lock);
+			return 0;
+		}
+
+		struct traceChunk *chunk = &pipeline->slots[pipeline->consumed % pipeline->numSlots];
+		while (chunk->index != pipeline->consumed || !chunk->ready) {
+			pthread_cond_wait(&pipeline->parsed, &pipeline->lock);
+		}
+		pthread_mutex_unlock(&pipeline->lock);
+
+		reader->chunk = chunk;
+		reader->chunkPos = 0;
+	}
+
+	*rec = reader->chunk->records[reader->chunkPos++];
+	reader->lastText = rec->text;
+	return 1;
+}
+
+// Decode the next record of a streamed trace, reading more of the stream whenever the buffer runs out of whole lines or
+// records.
+static int readStreamedRecord(struct traceReader *reader, struct traceRecord *rec) {
+	for (;;) {
+		if (reader->binary) {
+			if (reader->filled - reader->pos >= MAX_BINARY_RECORD || reader->eof) {
+				reader->end = reader->filled;
+				return readBinaryRecord(reader, rec);
+			}
+		} else if (readTextRecord(reader, rec)) {
+			return 1;
+		} else if (reader->eof) {
+			return 0;
+		}
+
+		refillTrace(reader);
+		holdPartialLine(reader);
+	}
+}
+
+// Fetch the next data access from the trace. Returns 0 once the trace is exhausted.
+int readRecord(struct traceReader *reader, struct traceRecord *rec) {
+	if (reader->pipeline != NULL) {
+		return readParsedRecord(reader, rec);
+	}
+	if (reader->streaming) {
+		return readStreamedRecord(reader, rec);
+	}
+	if (reader->binary) {
+		return readBinaryRecord(reader, rec);
+	}
+	return readTextRecord(reader, rec);
+}
+
+void openTraceWriter(struct traceWriter *writer, FILE *file) {
+	writer->file = file;
+	writer->lastAddr = 0;
+	fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LENGTH, file);
+}
+
+static int encodeVarint(unsigned long long value, unsigned char *out) {
+	int length = 0;
+	while (value >= 0x80) {
+		out[length++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	out[length++] = value;
+	return length;
+}
+
+// Append one access to a binary trace. Only L, S and M records can be represented.
+void writeRecord(struct traceWriter *writer, const struct traceRecord *rec) {
+	unsigned char buf[1 + 10 + 10];
+	int length = 0;
+	int op = strchr(opCodes, rec->op) - opCodes;
+
+	if (rec->size < 63) {
+		buf[length++] = op | (rec->size << 2);
+	} else {
+		buf[length++] = op | (63 << 2);
+		length += encodeVarint(rec->size, &buf[length]);
+	}
+
+	long long delta = rec->addr - writer->lastAddr;
+	length += encodeVarint(((unsigned long long)delta << 1) ^ (delta >> 63), &buf[length]);
+	writer->lastAddr = rec->addr;
+
+	fwrite(buf, 1, length, writer->file);
+}
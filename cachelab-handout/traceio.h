@@ -0,0 +1,141 @@
+/*
+ * traceio.h - Reading and writing memory traces for the cache simulator
+ *
+ * Two trace formats are understood. The text format is the one produced
+ * by valgrind's lackey tool:
+ *
+ *     I 0400d7d4,8
+ *      L 00602260,4
+ *      M 7ff000388,4
+ *
+ * The binary format is a compact encoding of the same data accesses.
+ * It starts with the 8 byte magic "CSIMTRB1" and is followed by one
+ * variable length record per access:
+ *
+ *     byte 0    bits 0-1: operation (0 = L, 1 = S, 2 = M)
+ *               bits 2-7: access size, or 63 if a varint size follows
+ *     [varint]  access size, only present when bits 2-7 are all set
+ *     varint    zigzag encoded difference to the previous address
+ *
+ * Varints are little endian base 128. Instruction fetches are dropped
+ * when a text trace is converted, since they never touch the data cache.
+ *
+ * A trace can also be streamed from stdin or a pipe, given as "-" or the
+ * pipe's path. It is then read through a buffer that always holds whole
+ * lines (or whole binary records), instead of being mapped.
+ *
+ * Traces compressed with gzip, zstd or xz are recognized by their magic
+ * bytes and streamed through the system's decompressor, which runs as a
+ * child process alongside the parser. When the compressed data itself
+ * comes from a pipe, a feeder thread copies it to the decompressor.
+ *
+ * Large text traces can be parsed by several threads. The mapping is cut
+ * into fixed size chunks, and a record belongs to the chunk holding the
+ * first character of its operation, so every thread can find the records
+ * of its chunk without looking at any other. Parsed chunks go into a
+ * small ring of slots and are handed out by readRecord in file order; a
+ * thread may only run a ring's length ahead of the consumer, so memory
+ * stays bounded no matter how large the trace is.
+ */
+
+#ifndef TRACEIO_H
+#define TRACEIO_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#define TRACE_MAGIC "CSIMTRB1"
+#define TRACE_MAGIC_LENGTH 8
+
+#define MAX_PARSERS 64
+#define TRACE_CHUNK_SIZE (1 << 20)   // Bytes of text per chunk parsed in parallel.
+#define TRACE_BUFFER_SIZE (1 << 20)  // Initial size of the buffer a streamed trace is read through.
+#define MAX_BINARY_RECORD 21         // Longest binary record: a header and two 10 byte varints.
+
+// One decoded data access.
+struct traceRecord {
+	char op;                    // 'L', 'S' or 'M'
+	unsigned long long addr;
+	unsigned int size;
+	const char *text;           // The record as written in a text trace, NULL for binary traces.
+	int textLength;
+};
+
+// The records parsed from one chunk of a text trace.
+struct traceChunk {
+	struct traceRecord *records;
+	int count;
+	int capacity;
+	long long index;            // The chunk held by this slot, or -1.
+	int ready;                  // Set once every record of the chunk has been parsed.
+};
+
+// Shared state of the parser threads. Everything below threads is protected by lock.
+struct tracePipeline {
+	pthread_t threads[MAX_PARSERS];
+	int numThreads;
+	int numSlots;
+	long long numChunks;
+	pthread_mutex_t lock;
+	pthread_cond_t parsed;      // Signalled when a chunk is ready.
+	pthread_cond_t released;    // Signalled when the consumer is done with a chunk.
+	struct traceChunk *slots;
+	const char *base;           // Where the first chunk starts.
+	long long nextChunk;        // The next chunk a parser will claim.
+	long long consumed;         // Chunks the consumer has finished with.
+	int stopping;
+};
+
+// A trace file mapped into memory and the decoding position within it.
+struct traceReader {
+	const char *data;
+	const char *pos;
+	const char *end;
+	size_t size;
+	int binary;
+	unsigned long long lastAddr;
+
+	// A streamed trace is read from fd into buffer. Only the bytes up to end are ready to be decoded, the rest up to
+	// filled is the start of a line or record that has not been read completely yet.
+	int streaming;
+	int fd;
+	int eof;
+	char *buffer;
+	size_t capacity;
+	const char *filled;
+
+	// The decompressor feeding fd, if any, and the thread copying compressed data from a pipe to it.
+	pid_t decompressor;
+	int feeding;
+	pthread_t feeder;
+	int sourceFd;
+	int feedFd;
+	char *prefix;               // Compressed bytes read before the compression was recognized.
+	size_t prefixLength;
+
+	// Set while parser threads feed the reader, along with the chunk being consumed.
+	struct tracePipeline *pipeline;
+	struct traceChunk *chunk;
+	int chunkPos;
+	const char *lastText;       // The text of the last record handed out by the parsers.
+};
+
+// Encoding state for a binary trace being written.
+struct traceWriter {
+	FILE *file;
+	unsigned long long lastAddr;
+};
+
+void openTrace(struct traceReader *reader, const char *path);
+void startTraceParsers(struct traceReader *reader, int numThreads);
+int readRecord(struct traceReader *reader, struct traceRecord *rec);
+void closeTrace(struct traceReader *reader);
+long long traceOffset(const struct traceReader *reader);
+void seekTrace(struct traceReader *reader, long long offset, unsigned long long lastAddr);
+
+void openTraceWriter(struct traceWriter *writer, FILE *file);
+void writeRecord(struct traceWriter *writer, const struct traceRecord *rec);
+
+#endif /* TRACEIO_H */
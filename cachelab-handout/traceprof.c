@@ -0,0 +1,285 @@
+/*
+ * traceprof.c - Characterize a memory trace independently of any cache
+ *     geometry. Prints the reuse distance histogram at block granularity,
+ *     the working set size of consecutive windows of the trace, and the
+ *     most common strides between consecutive accesses.
+ *
+ *     Reuse distances come from the single set stack distance engine, so
+ *     every access costs O(log n). Memory is bounded by -M, beyond which
+ *     the least recently used blocks are forgotten; the working set of a
+ *     window needs memory proportional to the window, and the stride
+ *     counts are a fixed size table.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "traceio.h"
+#include "stackdist.h"
+
+/* Reuse distances are bucketed by powers of two: 0, 1, 2-3, 4-7, ... */
+#define DIST_BUCKETS 64
+
+/* Strides between -MAX_STRIDE and MAX_STRIDE bytes are counted exactly */
+#define MAX_STRIDE 4096
+#define TOP_STRIDES 16
+
+/* Blocks distinct within the current window, in a table cleared per window */
+struct windowSet {
+    unsigned long long *blocks;     /* block + 1, 0 for an empty slot */
+    unsigned long long size;
+    unsigned long long used;
+};
+
+static unsigned long long distHist[DIST_BUCKETS];
+static unsigned long long strideHist[2 * MAX_STRIDE + 1];
+static unsigned long long strideOther;
+
+/*
+ * usage - Print usage info
+ */
+void usage(char *argv[]) {
+    printf("Usage: %s [-h] [-b <num>] [-w <num>] [-M <num>] -t <file>\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h         Print this help message.\n");
+    printf("  -b <num>   Number of block offset bits (default 6).\n");
+    printf("  -w <num>   Records per working set window (default 1000000).\n");
+    printf("  -M <num>   Most blocks remembered for reuse distances, at least 1 (default 16777216).\n");
+    printf("  -t <file>  Trace file, text or binary, compressed or not. Use - for stdin.\n");
+    printf("Example: %s -b 6 -w 100000 -t traces/long.trace\n", argv[0]);
+}
+
+/*
+ * bucketOf - The power of two bucket of a reuse distance
+ */
+static int bucketOf(long long distance)
+{
+    int bucket = 0;
+    while (distance > 0) {
+        distance >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static unsigned long long hashBlock(unsigned long long block)
+{
+    block ^= block >> 33;
+    block *= 0xFF51AFD7ED558CCDULL;
+    return block ^ (block >> 33);
+}
+
+/*
+ * addToWindow - Add a block to the set of the current window, growing
+ *     the table to keep it at most half full
+ */
+static void addToWindow(struct windowSet *set, unsigned long long block)
+{
+    if (2 * (set->used + 1) > set->size) {
+        unsigned long long *old = set->blocks;
+        unsigned long long oldSize = set->size;
+
+        set->size = set->size ? 2 * set->size : 1024;
+        set->blocks = calloc(set->size, sizeof(unsigned long long));
+        if (set->blocks == NULL) {
+            printf("Error: out of memory\n");
+            exit(1);
+        }
+        set->used = 0;
+        for (unsigned long long i = 0; i < oldSize; i++) {
+            if (old[i] != 0) {
+                addToWindow(set, old[i] - 1);
+            }
+        }
+        free(old);
+    }
+
+    unsigned long long slot = hashBlock(block) & (set->size - 1);
+    while (set->blocks[slot] != 0) {
+        if (set->blocks[slot] == block + 1) {
+            return;
+        }
+        slot = (slot + 1) & (set->size - 1);
+    }
+    set->blocks[slot] = block + 1;
+    set->used++;
+}
+
+/*
+ * printReuse - Print the reuse distance histogram. An access hits in a
+ *     fully associative LRU cache of n blocks when its distance is below
+ *     n, so the cumulative share of a row is the hit ratio of such a
+ *     cache with one block more than the upper end of the row, which is
+ *     printed as LRU blocks.
+ */
+static void printReuse(const struct stackDist *sd)
+{
+    unsigned long long cumulative = 0;
+
+    printf("Reuse distance (blocks)\n");
+    printf("%24s %14s %8s %8s %12s\n", "distance", "accesses", "share", "cumul.", "LRU blocks");
+    for (int bucket = 0; bucket < DIST_BUCKETS; bucket++) {
+        char range[48];
+
+        if (distHist[bucket] == 0) {
+            continue;
+        }
+        cumulative += distHist[bucket];
+        if (bucket <= 1) {
+            snprintf(range, sizeof(range), "%d", bucket);
+        } else {
+            snprintf(range, sizeof(range), "%llu-%llu", 1ULL << (bucket - 1), (1ULL << bucket) - 1);
+        }
+        printf("%24s %14llu %7.2f%% %7.2f%% %12llu\n", range, distHist[bucket],
+               100.0 * distHist[bucket] / sd->accesses, 100.0 * cumulative / sd->accesses, 1ULL << bucket);
+    }
+    printf("%24s %14llu %7.2f%%\n", sd->forgotten ? "cold or forgotten" : "cold",
+           sd->cold, 100.0 * sd->cold / (sd->accesses ? sd->accesses : 1));
+    if (sd->forgotten) {
+        printf("distinct blocks: more than %llu, the -M limit\n", sd->maxBlocks);
+    } else {
+        printf("distinct blocks: %llu\n", sd->cold);
+    }
+}
+
+/*
+ * printStrides - Print the most common strides, largest count first
+ */
+static void printStrides(unsigned long long total)
+{
+    int top[TOP_STRIDES];
+    int numTop = 0;
+
+    for (int i = 0; i <= 2 * MAX_STRIDE; i++) {
+        int pos;
+
+        if (strideHist[i] == 0) {
+            continue;
+        }
+        for (pos = numTop; pos > 0 && strideHist[top[pos - 1]] < strideHist[i]; pos--) {
+            if (pos < TOP_STRIDES) {
+                top[pos] = top[pos - 1];
+            }
+        }
+        if (pos < TOP_STRIDES) {
+            top[pos] = i;
+            if (numTop < TOP_STRIDES) {
+                numTop++;
+            }
+        }
+    }
+
+    printf("\nStrides between consecutive accesses (bytes)\n");
+    printf("%12s %14s %8s\n", "stride", "count", "share");
+    for (int i = 0; i < numTop; i++) {
+        printf("%12d %14llu %7.2f%%\n", top[i] - MAX_STRIDE, strideHist[top[i]],
+               100.0 * strideHist[top[i]] / total);
+    }
+    printf("%12s %14llu %7.2f%%\n", "other", strideOther, 100.0 * strideOther / (total ? total : 1));
+}
+
+int main(int argc, char *argv[])
+{
+    struct traceReader reader;
+    struct traceRecord rec;
+    struct stackDist sd;
+    struct windowSet window;
+    char *trace = NULL;
+    int blockBits = 6;
+    unsigned long long windowRecords = 1000000;
+    unsigned long long maxBlocks = 1 << 24;
+    unsigned long long records = 0;
+    unsigned long long strides = 0;
+    unsigned long long lastAddr = 0;
+    unsigned long long windowStart = 0;
+    unsigned long long minSet = ~0ULL, maxSet = 0, sumSet = 0, numWindows = 0;
+    char c;
+
+    while ((c = getopt(argc, argv, "b:w:M:t:h")) != -1) {
+        switch (c) {
+        case 'b':
+            blockBits = atoi(optarg);
+            break;
+        case 'w':
+            windowRecords = strtoull(optarg, NULL, 0);
+            break;
+        case 'M':
+            maxBlocks = strtoull(optarg, NULL, 0);
+            break;
+        case 't':
+            trace = optarg;
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    if (trace == NULL || blockBits < 0 || blockBits > 63 || windowRecords == 0 || maxBlocks == 0) {
+        usage(argv);
+        exit(1);
+    }
+
+    createStackDist(&sd, 0, blockBits, 0);
+    setStackDistLimit(&sd, maxBlocks);
+    memset(&window, 0, sizeof(window));
+    openTrace(&reader, trace);
+
+    printf("%10s %14s %14s %14s\n", "window", "first record", "blocks", "bytes");
+    while (readRecord(&reader, &rec)) {
+        if (rec.op != 'L' && rec.op != 'S' && rec.op != 'M') {
+            continue;
+        }
+
+        /* A modify is a load and a store; the store always reuses at distance 0 */
+        long long distance = accessStackDist(&sd, rec.addr);
+        if (distance != STACKDIST_COLD) {
+            distHist[bucketOf(distance)]++;
+        }
+        if (rec.op == 'M') {
+            distHist[bucketOf(accessStackDist(&sd, rec.addr))]++;
+        }
+
+        if (records > 0) {
+            long long stride = rec.addr - lastAddr;
+            if (stride >= -MAX_STRIDE && stride <= MAX_STRIDE) {
+                strideHist[stride + MAX_STRIDE]++;
+            } else {
+                strideOther++;
+            }
+            strides++;
+        }
+        lastAddr = rec.addr;
+
+        addToWindow(&window, rec.addr >> blockBits);
+        if (++records - windowStart == windowRecords) {
+            printf("%10llu %14llu %14llu %14llu\n", numWindows, windowStart, window.used,
+                   window.used << blockBits);
+            minSet = window.used < minSet ? window.used : minSet;
+            maxSet = window.used > maxSet ? window.used : maxSet;
+            sumSet += window.used;
+            numWindows++;
+            windowStart = records;
+            memset(window.blocks, 0, window.size * sizeof(unsigned long long));
+            window.used = 0;
+        }
+    }
+    closeTrace(&reader);
+
+    if (numWindows > 0) {
+        printf("working set over %llu full windows of %llu records: min %llu, mean %.1f, max %llu blocks\n\n",
+               numWindows, windowRecords, minSet, (double)sumSet / numWindows, maxSet);
+    } else {
+        printf("the trace is shorter than one window\n\n");
+    }
+    printf("records: %llu accesses: %llu\n", records, sd.accesses);
+    printReuse(&sd);
+    printStrides(strides);
+
+    free(window.blocks);
+    freeStackDist(&sd);
+    return 0;
+}
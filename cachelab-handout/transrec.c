@@ -0,0 +1,243 @@
+/*
+ * transrec.c - Record the memory accesses of transpose functions
+ *     straight into a simulated cache
+ */
+#define _DEFAULT_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "transrec.h"
+
+/* Stack size assumed when the limit is unlimited */
+#define DEFAULT_STACK_SIZE (8ULL << 20)
+
+/* Longest symbol name read from nm */
+#define MAX_SYMBOL_NAME 256
+
+/* A data symbol as listed by nm */
+struct symbol {
+    char name[MAX_SYMBOL_NAME];
+    unsigned long long addr;
+    unsigned long long size;
+};
+
+/* Where a data symbol of this program lives in the program accesses
+   are rebased onto */
+struct rebase {
+    uintptr_t start;
+    uintptr_t end;
+    unsigned long long target;
+};
+
+static struct csimSim *recordSim = NULL;
+static uintptr_t stackLow, stackHigh;
+static struct rebase *rebases = NULL;     /* sorted by start */
+static int numRebases = 0;
+
+/*
+ * readSymbols - Read the defined data and bss symbols of the program at
+ *     path with nm. Returns how many were read, or -1 if none could be.
+ */
+static int readSymbols(const char *path, struct symbol **symbols)
+{
+    char cmd[4200], line[512], name[MAX_SYMBOL_NAME], type;
+    unsigned long long addr, size;
+    int count = 0, capacity = 0;
+
+    *symbols = NULL;
+    snprintf(cmd, sizeof(cmd), "nm -S --defined-only '%s' 2>/dev/null", path);
+    FILE *fp = popen(cmd, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "%llx %llx %c %255s", &addr, &size, &type, name) != 4 ||
+            strchr("bBdD", type) == NULL) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? 2 * capacity : 64;
+            *symbols = realloc(*symbols, capacity * sizeof(struct symbol));
+            if (*symbols == NULL) {
+                pclose(fp);
+                return -1;
+            }
+        }
+        snprintf((*symbols)[count].name, MAX_SYMBOL_NAME, "%s", name);
+        (*symbols)[count].addr = addr;
+        (*symbols)[count].size = size;
+        count++;
+    }
+    if (pclose(fp) != 0 || count == 0) {
+        free(*symbols);
+        *symbols = NULL;
+        return -1;
+    }
+    return count;
+}
+
+/*
+ * findSymbol - Return the index of the only symbol with the given name,
+ *     or -1 if there is none or the name is ambiguous
+ */
+static int findSymbol(const struct symbol *symbols, int count, const char *name)
+{
+    int found = -1;
+
+    for (int i = 0; i < count; i++) {
+        if (strcmp(symbols[i].name, name) == 0) {
+            if (found >= 0) {
+                return -1;
+            }
+            found = i;
+        }
+    }
+    return found;
+}
+
+static int compareRebases(const void *a, const void *b)
+{
+    const struct rebase *left = a;
+    const struct rebase *right = b;
+    return (left->start > right->start) - (left->start < right->start);
+}
+
+/*
+ * rebaseOnto - Translate accesses to the data symbols this program
+ *     shares with the program at path, such as the matrices, M, N, the
+ *     markers and func_list, to the addresses they have there. The
+ *     symbols are matched by name and size. Returns 0, or -1 if no
+ *     symbol could be matched.
+ */
+int rebaseOnto(const char *path)
+{
+    struct symbol *own = NULL, *other;
+    char selfPath[4096];
+    ssize_t length = readlink("/proc/self/exe", selfPath, sizeof(selfPath) - 1);
+    int numOwn = -1;
+
+    /* nm runs in a shell of its own, so find this program's file first */
+    if (length > 0) {
+        selfPath[length] = '\0';
+        numOwn = readSymbols(selfPath, &own);
+    }
+    int numOther = readSymbols(path, &other);
+    int self = (numOwn > 0) ? findSymbol(own, numOwn, "recordSim") : -1;
+
+    free(rebases);
+    rebases = NULL;
+    numRebases = 0;
+    if (numOther > 0 && self >= 0) {
+        /* This program may be loaded anywhere; one of its own symbols gives the offset */
+        uintptr_t base = (uintptr_t) &recordSim - own[self].addr;
+
+        rebases = malloc(numOwn * sizeof(struct rebase));
+        for (int i = 0; rebases != NULL && i < numOwn; i++) {
+            int j = findSymbol(other, numOther, own[i].name);
+            if (j >= 0 && own[i].size == other[j].size && own[i].size > 0 &&
+                findSymbol(own, numOwn, own[i].name) == i) {
+                rebases[numRebases].start = base + own[i].addr;
+                rebases[numRebases].end = base + own[i].addr + own[i].size;
+                rebases[numRebases].target = other[j].addr;
+                numRebases++;
+            }
+        }
+        qsort(rebases, numRebases, sizeof(struct rebase), compareRebases);
+    }
+    free(own);
+    free(other);
+    return numRebases > 0 ? 0 : -1;
+}
+
+/*
+ * rebase - The address the access would have in the program rebased
+ *     onto, or the address itself if it is to none of the shared symbols
+ */
+static unsigned long long rebase(uintptr_t address)
+{
+    int low = 0, high = numRebases;
+
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (rebases[middle].end <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low < numRebases && rebases[low].start <= address) {
+        return rebases[low].target + (address - rebases[low].start);
+    }
+    return address;
+}
+
+/*
+ * startRecording - Send accesses to sim, ignoring those to the stack
+ *     below stackTop. The stack is taken to extend as far as its limit.
+ */
+void startRecording(struct csimSim *sim, const void *stackTop)
+{
+    struct rlimit limit;
+    unsigned long long size = DEFAULT_STACK_SIZE;
+
+    if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        size = limit.rlim_cur;
+    }
+    stackHigh = (uintptr_t) stackTop;
+    stackLow = stackHigh > size ? stackHigh - size : 0;
+    recordSim = sim;
+}
+
+void stopRecording(void)
+{
+    recordSim = NULL;
+}
+
+/*
+ * recordAccess - Simulate one access, unless it is to the stack or
+ *     nothing is being recorded
+ */
+void recordAccess(const void *addr, unsigned int size, int write)
+{
+    uintptr_t address = (uintptr_t) addr;
+
+    if (recordSim == NULL || (address >= stackLow && address < stackHigh)) {
+        return;
+    }
+    csimAccess(recordSim, write ? 'S' : 'L', rebase(address), size);
+}
+
+/*
+ * The hooks called by code compiled with -fsanitize=thread. Calls to
+ * them are only ever emitted into trans.c, so the thread sanitizer
+ * runtime itself is never linked in.
+ */
+void __tsan_init(void) {}
+void __tsan_func_entry(void *caller) {}
+void __tsan_func_exit(void) {}
+
+void __tsan_read1(void *addr) { recordAccess(addr, 1, 0); }
+void __tsan_read2(void *addr) { recordAccess(addr, 2, 0); }
+void __tsan_read4(void *addr) { recordAccess(addr, 4, 0); }
+void __tsan_read8(void *addr) { recordAccess(addr, 8, 0); }
+void __tsan_read16(void *addr) { recordAccess(addr, 16, 0); }
+void __tsan_write1(void *addr) { recordAccess(addr, 1, 1); }
+void __tsan_write2(void *addr) { recordAccess(addr, 2, 1); }
+void __tsan_write4(void *addr) { recordAccess(addr, 4, 1); }
+void __tsan_write8(void *addr) { recordAccess(addr, 8, 1); }
+void __tsan_write16(void *addr) { recordAccess(addr, 16, 1); }
+
+void __tsan_unaligned_read2(void *addr) { recordAccess(addr, 2, 0); }
+void __tsan_unaligned_read4(void *addr) { recordAccess(addr, 4, 0); }
+void __tsan_unaligned_read8(void *addr) { recordAccess(addr, 8, 0); }
+void __tsan_unaligned_read16(void *addr) { recordAccess(addr, 16, 0); }
+void __tsan_unaligned_write2(void *addr) { recordAccess(addr, 2, 1); }
+void __tsan_unaligned_write4(void *addr) { recordAccess(addr, 4, 1); }
+void __tsan_unaligned_write8(void *addr) { recordAccess(addr, 8, 1); }
+void __tsan_unaligned_write16(void *addr) { recordAccess(addr, 16, 1); }
+
+void __tsan_read_range(void *addr, unsigned long size) { recordAccess(addr, size, 0); }
+void __tsan_write_range(void *addr, unsigned long size) { recordAccess(addr, size, 1); }
@@ -0,0 +1,39 @@
+/*
+ * transrec.h - Record the memory accesses of transpose functions
+ *     straight into a simulated cache
+ *
+ * test-trans used to run every transpose function under valgrind,
+ * write the whole trace of the process to disk, cut out the part
+ * between the markers and hand it to csim-ref. Instead, trans.c is
+ * compiled a second time with -fsanitize=thread, which makes gcc call
+ * __tsan_read<n>/__tsan_write<n> before every load and store that may
+ * touch memory shared with other code. Locals kept in registers or
+ * private stack slots are not instrumented. This file defines those
+ * hooks without the thread sanitizer runtime: while recording, each
+ * access goes to a libcsim simulator as it happens. Accesses to the
+ * stack are dropped, just like the old filter on valgrind traces did.
+ *
+ * The matrices and markers of test-trans sit elsewhere than those of
+ * tracegen, which would shift the sets the accesses map to. Accesses to
+ * data symbols the two programs share are therefore rebased onto
+ * tracegen's addresses, read with nm, so that the simulated cache sees
+ * exactly the trace valgrind would have recorded.
+ */
+#ifndef TRANSREC_H
+#define TRANSREC_H
+
+#include "libcsim.h"
+
+/* Send accesses to sim until stopRecording, ignoring those to the
+   stack below stackTop */
+void startRecording(struct csimSim *sim, const void *stackTop);
+void stopRecording(void);
+
+/* Rebase accesses onto the data symbols of the program at path;
+   returns -1 if its symbols could not be read */
+int rebaseOnto(const char *path);
+
+/* Record an access made by uninstrumented code */
+void recordAccess(const void *addr, unsigned int size, int write);
+
+#endif /* TRANSREC_H */